@@ -0,0 +1,96 @@
+/*
+ * arena.c - implementation of a bump allocator
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "arena.h"
+
+#define ARENA_MIN_CHUNK	512
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+/* Allocations are only freed all at once, the newest chunk comes first */
+struct arena {
+	struct arena_chunk *chunks;
+};
+
+void *arena_alloc(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk = arena->chunks;
+	size_t chunk_size;
+	void *ptr;
+
+	/* Keep allocations aligned for any type */
+	size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+	if (!chunk || chunk->size - chunk->used < size) {
+		chunk_size = chunk ? chunk->size * 2 : ARENA_MIN_CHUNK;
+		while (chunk_size < size)
+			chunk_size *= 2;
+
+		chunk = malloc(sizeof(struct arena_chunk) + chunk_size);
+		if (!chunk)
+			return NULL;
+
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	ptr = chunk->data + chunk->used;
+	chunk->used += size;
+
+	return ptr;
+}
+
+/* Free everything but the largest chunk, which likely fits the next round */
+void arena_reset(struct arena *arena)
+{
+	struct arena_chunk *chunk = arena->chunks;
+	struct arena_chunk *next;
+
+	if (!chunk)
+		return;
+
+	next = chunk->next;
+	while (next) {
+		chunk->next = next->next;
+		free(next);
+		next = chunk->next;
+	}
+
+	chunk->used = 0;
+}
+
+void arena_destroy(struct arena *arena)
+{
+	arena_reset(arena);
+	free(arena->chunks);
+	free(arena);
+}
+
+struct arena *arena_create(void)
+{
+	return calloc(1, sizeof(struct arena));
+}
@@ -17,6 +17,7 @@
  */
 
 #include <signal.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -24,11 +25,13 @@
 #include "bar.h"
 #include "block.h"
 #include "config.h"
+#include "heap.h"
 #include "json.h"
 #include "line.h"
 #include "log.h"
 #include "map.h"
 #include "sched.h"
+#include "spawner.h"
 #include "sys.h"
 #include "term.h"
 
@@ -48,6 +51,37 @@ static void bar_print(struct bar *bar)
 	err = i3bar_print(bar);
 	if (err)
 		fatal("failed to print bar!");
+
+	bar->dirty = false;
+}
+
+/* Render the bar if needed, at most once per frame */
+static void bar_flush(struct bar *bar)
+{
+	unsigned long long now;
+	int err;
+
+	if (!bar->dirty)
+		return;
+
+	err = sys_gettime(&now);
+	if (err)
+		return;
+
+	if (now < bar->rendered + bar->frame) {
+		/* Coalesce with the next updates until the end of the frame */
+		if (!heap_queued(&bar->redraw)) {
+			err = heap_update(bar->timers, &bar->redraw,
+					  bar->rendered + bar->frame);
+			if (err)
+				bar_print(bar);
+		}
+
+		return;
+	}
+
+	bar_print(bar);
+	bar->rendered = now;
 }
 
 static int bar_start(struct bar *bar)
@@ -70,14 +104,60 @@ static void bar_stop(struct bar *bar)
 	debug("bar stopped");
 }
 
+/* Spawn a timed block, or queue it by deadline if too many commands run */
+static void bar_spawn(struct bar *bar, struct block *block,
+		      unsigned long long deadline)
+{
+	int err;
+
+	/* Do not overtake blocks queued with an earlier deadline either */
+	if (bar->jobs && block->command && !block->builtin &&
+	    block->interval != INTERVAL_PERSIST &&
+	    (bar->running >= bar->jobs || heap_peek(bar->queue))) {
+		/* Keep the earliest deadline of a block queued already */
+		if (heap_queued(&block->queued))
+			return;
+
+		block_debug(block, "queued");
+		err = heap_update(bar->queue, &block->queued, deadline);
+		if (err)
+			block_error(block, "failed to queue block");
+
+		return;
+	}
+
+	block_spawn(block);
+}
+
+/* Spawn queued blocks as commands exit */
+static void bar_drain(struct bar *bar)
+{
+	struct heap_node *node;
+
+	while (bar->running < bar->jobs) {
+		node = heap_peek(bar->queue);
+		if (!node)
+			break;
+
+		heap_remove(bar->queue, node);
+		block_spawn(node->data);
+	}
+}
+
 static void bar_poll_timed(struct bar *bar)
 {
 	struct block *block = bar->blocks;
+	unsigned long long now;
+	int err;
+
+	err = sys_gettime(&now);
+	if (err)
+		return;
 
 	while (block) {
 		/* spawn unless it is only meant for click or signal */
 		if (block->interval != 0) {
-			block_spawn(block);
+			bar_spawn(bar, block, now);
 			block_touch(block);
 		}
 
@@ -86,27 +166,113 @@ static void bar_poll_timed(struct bar *bar)
 }
 
 static void bar_poll_expired(struct bar *bar)
+{
+	struct heap_node *node;
+	struct block *block;
+	unsigned long long now;
+	uint64_t expirations;
+	int err;
+
+	/* The timer fired, it is not armed anymore */
+	err = sys_read(bar->timerfd, &expirations, sizeof(expirations), NULL);
+	if (err && err != -EAGAIN)
+		return;
+
+	bar->alarm = 0;
+
+	err = sys_gettime(&now);
+	if (err)
+		return;
+
+	/* Touching a block queues its next update after now */
+	while ((node = heap_peek(bar->timers))) {
+		if (node->key > now)
+			break;
+
+		/* End of the frame, the bar is flushed after polling */
+		if (node == &bar->redraw) {
+			heap_remove(bar->timers, node);
+			continue;
+		}
+
+		block = node->data;
+
+		/* A command ran past its timeout */
+		if (node == &block->watchdog) {
+			block_expire(block);
+			continue;
+		}
+
+		block_debug(block, "expired");
+		bar_spawn(bar, block, node->key);
+		block_touch(block);
+	}
+}
+
+/* Wall-clock blocks are dequeued first, then always requeued */
+static void bar_poll_clock(struct bar *bar, struct block *block,
+			   unsigned long long now)
+{
+	int err;
+
+	bar_spawn(bar, block, now);
+
+	/* Touching is skipped for a block touched within this millisecond */
+	block_touch(block);
+
+	err = block_schedule(block);
+	if (err)
+		block_error(block, "failed to schedule block");
+}
+
+static void bar_poll_clocked(struct bar *bar)
 {
 	struct block *block = bar->blocks;
+	struct heap_node *node;
+	unsigned long long now, real;
+	uint64_t expirations;
+	long long gmtoff;
+	bool jumped;
+	int err;
 
-	while (block) {
-		if (block->interval > 0) {
-			const unsigned long next_update = block->timestamp + block->interval;
-			unsigned long now;
-			int err;
+	/* The clock was set (or jumped), all deadlines are stale */
+	err = sys_read(bar->clockfd, &expirations, sizeof(expirations), NULL);
+	jumped = err == -ECANCELED;
+	if (err && err != -EAGAIN && !jumped)
+		return;
 
-			err = sys_gettime(&now);
-			if (err)
-				return;
+	bar->clockalarm = 0;
 
-			if (((long) (next_update - now)) <= 0) {
-				block_debug(block, "expired");
-				block_spawn(block);
-				block_touch(block);
+	err = sys_gettime(&now);
+	if (err)
+		return;
+
+	if (jumped) {
+		while (block) {
+			if (block->wallclock) {
+				block_debug(block, "clock changed");
+				heap_remove(bar->clocks, &block->timer);
+				bar_poll_clock(bar, block, now);
 			}
+
+			block = block->next;
 		}
+	}
 
-		block = block->next;
+	err = sys_getrealtime(&real, &gmtoff);
+	if (err)
+		return;
+
+	/* Deadlines are in real time, but the spawn queue is monotonic */
+	while ((node = heap_peek(bar->clocks))) {
+		if (node->key > real)
+			break;
+
+		heap_remove(bar->clocks, node);
+
+		block = node->data;
+		block_debug(block, "expired");
+		bar_poll_clock(bar, block, now);
 	}
 }
 
@@ -125,6 +291,81 @@ static void bar_poll_signaled(struct bar *bar, int sig)
 	}
 }
 
+static struct block **bar_child_bucket(struct bar *bar, pid_t pid)
+{
+	return &bar->children[pid & (bar->nchildren - 1)];
+}
+
+void bar_child_add(struct bar *bar, struct block *block)
+{
+	struct block **bucket = bar_child_bucket(bar, block->pid);
+
+	block->next_child = *bucket;
+	*bucket = block;
+}
+
+void bar_child_del(struct bar *bar, struct block *block)
+{
+	struct block **bucket = bar_child_bucket(bar, block->pid);
+
+	while (*bucket) {
+		if (*bucket == block) {
+			*bucket = block->next_child;
+			break;
+		}
+
+		bucket = &(*bucket)->next_child;
+	}
+
+	block->next_child = NULL;
+}
+
+static struct block *bar_child(struct bar *bar, pid_t pid)
+{
+	struct block *block = *bar_child_bucket(bar, pid);
+
+	while (block) {
+		if (block->pid == pid)
+			break;
+
+		block = block->next_child;
+	}
+
+	return block;
+}
+
+/* Update a block from its reaped process, unless it timed out */
+static void bar_poll_child(struct bar *bar, struct block *block, int err)
+{
+	const char *full_text;
+	char *error = NULL;
+
+	if (block->interval == INTERVAL_PERSIST) {
+		block_debug(block, "unexpected exit?");
+	} else if (err == -ETIME) {
+		/* Partial output is dropped, the timeout error stays */
+		block_debug(block, "not updated");
+	} else {
+		/* Keep the error just reported on exit, if shown at all */
+		full_text = block_get(block, "full_text");
+		if (err && block->tainted && full_text)
+			error = strdup(full_text);
+
+		block_update(block);
+
+		/* The update reset it, show it again */
+		if (error) {
+			block_printf(block, LOG_ERROR, "%s", error);
+			free(error);
+		}
+	}
+	block_close(block);
+	if (block->interval == INTERVAL_REPEAT) {
+		bar_spawn(bar, block, block->timestamp);
+		block_touch(block);
+	}
+}
+
 static void bar_poll_exited(struct bar *bar)
 {
 	struct block *block;
@@ -137,27 +378,19 @@ static void bar_poll_exited(struct bar *bar)
 			break;
 
 		/* Find the dead process */
-		block = bar->blocks;
-		while (block) {
-			if (block->pid == pid)
-				break;
-
-			block = block->next;
-		}
+		block = bar_child(bar, pid);
 
 		if (block) {
 			block_debug(block, "exited");
-			block_reap(block);
-			if (block->interval == INTERVAL_PERSIST) {
-				block_debug(block, "unexpected exit?");
-			} else {
-				block_update(block);
-			}
-			block_close(block);
-			if (block->interval == INTERVAL_REPEAT) {
-				block_spawn(block);
-				block_touch(block);
-			}
+			err = block_reap(block);
+			bar_poll_child(bar, block, err);
+		} else if (pid == bar->spawner_pid) {
+			error("spawner process %d exited", pid);
+			err = sys_waitpid(pid, NULL);
+			if (err)
+				break;
+
+			bar->spawner_pid = 0;
 		} else {
 			error("unknown child process %d", pid);
 			err = sys_waitpid(pid, NULL);
@@ -167,35 +400,229 @@ static void bar_poll_exited(struct bar *bar)
 	}
 }
 
-static void bar_poll_readable(struct bar *bar, const int fd)
+/* Queue a spawn request until the spawner socket becomes writable */
+int bar_request(struct bar *bar, struct block *block)
+{
+	block->next_request = NULL;
+
+	if (bar->requests) {
+		bar->last_request->next_request = block;
+		bar->last_request = block;
+		return 0;
+	}
+
+	bar->requests = bar->last_request = block;
+
+	block_debug(block, "spawn request queued");
+
+	return sys_epoll_out(bar->epfd, bar->spawner, true);
+}
+
+static struct block *bar_request_pop(struct bar *bar)
+{
+	struct block *block = bar->requests;
+
+	bar->requests = block->next_request;
+	block->next_request = NULL;
+
+	return block;
+}
+
+static void bar_poll_requests(struct bar *bar)
+{
+	struct block *block;
+	int err;
+
+	while (bar->requests) {
+		err = block_request_send(bar->requests);
+		if (err == -EAGAIN)
+			return;
+
+		block = bar_request_pop(bar);
+		if (err)
+			block_spawned(block, 0, err);
+	}
+
+	err = sys_epoll_out(bar->epfd, bar->spawner, false);
+	if (err)
+		error("failed to stop watching the spawner for writing");
+}
+
+/* Without the spawner, commands it started can no longer be waited for */
+static void bar_spawner_lost(struct bar *bar)
 {
 	struct block *block = bar->blocks;
 
+	error("lost the spawner, spawning commands directly");
+
+	bar_unwatch(bar, bar->spawner);
+	sys_close(bar->spawner);
+	bar->spawner = -1;
+
+	/* Requests never sent fail like refused ones */
+	while (bar->requests)
+		block_spawned(bar_request_pop(bar), 0, -EPIPE);
+
 	while (block) {
-		if (block->out[0] == fd) {
-			block_debug(block, "readable");
-			block_update(block);
-			break;
+		if (block->pid < 0) {
+			block_spawned(block, 0, -EPIPE);
+		} else if (block->pid > 0) {
+			block_abandon(block);
+
+			if (block->interval == INTERVAL_REPEAT) {
+				bar_spawn(bar, block, block->timestamp);
+				block_touch(block);
+			}
 		}
 
 		block = block->next;
 	}
 }
 
-static int gcd(int a, int b)
+static void bar_poll_spawner(struct bar *bar, uint32_t events)
 {
-	while (b != 0)
-		a %= b, a ^= b, b ^= a, a ^= b;
+	struct spawner_msg msg;
+	struct block *block;
+	int err;
+
+	if (events & EPOLLOUT)
+		bar_poll_requests(bar);
+
+	for (;;) {
+		err = spawner_read(bar->spawner, &msg);
+		if (err) {
+			if (err != -EAGAIN)
+				bar_spawner_lost(bar);
+			break;
+		}
+
+		if (msg.type == SPAWNER_SPAWNED) {
+			block = (struct block *) (uintptr_t) msg.cookie;
+			block_spawned(block, msg.pid, msg.code);
+			continue;
+		}
 
-	return a;
+		block = bar_child(bar, msg.pid);
+		if (!block) {
+			error("unknown spawned process %d", msg.pid);
+			continue;
+		}
+
+		block_debug(block, "exited");
+		block->code = msg.code;
+		err = block_exit(block);
+		bar_poll_child(bar, block, err);
+	}
+}
+
+static void bar_poll_readable(struct bar *bar, const int fd)
+{
+	struct block *block = NULL;
+
+	if (fd < bar->nfds)
+		block = bar->fds[fd];
+
+	if (block) {
+		block_debug(block, "readable");
+		block_readable(block, fd);
+	}
+}
+
+/* Descriptors are small dense integers, index blocks directly with them */
+static int bar_index(struct bar *bar, struct block *block, int fd)
+{
+	struct block **fds;
+	unsigned int nfds;
+
+	if (fd >= bar->nfds) {
+		nfds = bar->nfds ? bar->nfds : 16;
+		while (nfds <= fd)
+			nfds *= 2;
+
+		fds = realloc(bar->fds, nfds * sizeof(struct block *));
+		if (!fds)
+			return -ENOMEM;
+
+		memset(fds + bar->nfds, 0,
+		       (nfds - bar->nfds) * sizeof(struct block *));
+		bar->fds = fds;
+		bar->nfds = nfds;
+	}
+
+	bar->fds[fd] = block;
+
+	return 0;
+}
+
+int bar_watch(struct bar *bar, struct block *block, int fd)
+{
+	int err;
+
+	err = bar_index(bar, block, fd);
+	if (err)
+		return err;
+
+	err = sys_nonblock(fd, true);
+	if (err)
+		return err;
+
+	/* Registered once the event loop is set up */
+	if (bar->epfd < 0)
+		return 0;
+
+	return sys_epoll_add(bar->epfd, fd);
+}
+
+void bar_unwatch(struct bar *bar, int fd)
+{
+	int err;
+
+	if (fd < bar->nfds)
+		bar->fds[fd] = NULL;
+
+	if (bar->epfd < 0)
+		return;
+
+	/* Forked children may still refer to the file, remove it explicitly */
+	err = sys_epoll_del(bar->epfd, fd);
+	if (err && err != -ENOENT)
+		error("failed to unwatch descriptor %d", fd);
+}
+
+/* Arm a single one-shot timer for the earliest deadline of each clock */
+static int bar_schedule(struct bar *bar)
+{
+	struct heap_node *node = heap_peek(bar->timers);
+	int err;
+
+	/* A deadline already passed expires immediately */
+	if (node && node->key != bar->alarm) {
+		err = sys_timerfd_settime(bar->timerfd, node->key);
+		if (err)
+			return err;
+
+		bar->alarm = node->key;
+	}
+
+	/* Likewise in real time, also notified when the clock is set */
+	node = heap_peek(bar->clocks);
+	if (node && node->key != bar->clockalarm) {
+		err = sys_clockfd_settime(bar->clockfd, node->key);
+		if (err)
+			return err;
+
+		bar->clockalarm = node->key;
+	}
+
+	return 0;
 }
 
 static int bar_setup(struct bar *bar)
 {
 	struct block *block = bar->blocks;
 	sigset_t *set = &bar->sigset;
-	unsigned long sleeptime = 0;
-	int sig;
+	unsigned int count = 0;
+	int sig, fd;
 	int err;
 
 	while (block) {
@@ -203,19 +630,19 @@ static int bar_setup(struct bar *bar)
 		if (err)
 			return err;
 
-		/* The maximum sleep time is actually the GCD
-		 * between all positive block intervals.
-		 */
-		if (block->interval > 0) {
-			if (sleeptime > 0)
-				sleeptime = gcd(sleeptime, block->interval);
-			else
-				sleeptime = block->interval;
-		}
-
 		block = block->next;
+		count++;
 	}
 
+	/* At most one process per block, keep the PID table half full */
+	bar->nchildren = 1;
+	while (bar->nchildren < 2 * count)
+		bar->nchildren *= 2;
+
+	bar->children = calloc(bar->nchildren, sizeof(struct block *));
+	if (!bar->children)
+		return -ENOMEM;
+
 	err = sys_sigemptyset(set);
 	if (err)
 		return err;
@@ -229,11 +656,6 @@ static int bar_setup(struct bar *bar)
 	if (err)
 		return err;
 
-	/* Timer signal */
-	err = sys_sigaddset(set, SIGALRM);
-	if (err)
-		return err;
-
 	/* Block updates (forks) */
 	err = sys_sigaddset(set, SIGCHLD);
 	if (err)
@@ -248,16 +670,6 @@ static int bar_setup(struct bar *bar)
 	if (err)
 		return err;
 
-	/* Click signal */
-	err = sys_sigaddset(set, SIGIO);
-	if (err)
-		return err;
-
-	/* I/O Possible signal for persistent blocks */
-	err = sys_sigaddset(set, SIGRTMIN);
-	if (err)
-		return err;
-
 	/* Real-time signals for blocks */
 	for (sig = SIGRTMIN + 1; sig <= SIGRTMAX; sig++) {
 		err = sys_sigaddset(set, sig);
@@ -265,24 +677,65 @@ static int bar_setup(struct bar *bar)
 			return err;
 	}
 
-	/* Block signals for which we are interested in waiting */
+	/* Block signals for which we are interested in reading */
 	err = sys_sigsetmask(set);
 	if (err)
 		return err;
 
-	if (sleeptime) {
-		err = sys_setitimer(sleeptime);
+	err = sys_signalfd(set, &bar->sigfd);
+	if (err)
+		return err;
+
+	/* Timer for blocks with a positive interval */
+	err = sys_timerfd_create(&bar->timerfd);
+	if (err)
+		return err;
+
+	/* Timer for blocks aligned to the wall clock */
+	err = sys_clockfd_create(&bar->clockfd);
+	if (err)
+		return err;
+
+	err = sys_epoll_create(&bar->epfd);
+	if (err)
+		return err;
+
+	err = sys_epoll_add(bar->epfd, bar->sigfd);
+	if (err)
+		return err;
+
+	err = sys_epoll_add(bar->epfd, bar->timerfd);
+	if (err)
+		return err;
+
+	err = sys_epoll_add(bar->epfd, bar->clockfd);
+	if (err)
+		return err;
+
+	if (bar->spawner >= 0) {
+		err = sys_epoll_add(bar->epfd, bar->spawner);
 		if (err)
 			return err;
 	}
 
+	/* Descriptors watched by blocks during their setup */
+	for (fd = 0; fd < bar->nfds; fd++) {
+		if (bar->fds[fd]) {
+			err = sys_epoll_add(bar->epfd, fd);
+			if (err)
+				return err;
+		}
+	}
+
 	err = sys_cloexec(STDIN_FILENO);
 	if (err)
 		return err;
 
-	/* Setup event I/O for stdin (clicks) */
-	err = sys_async(STDIN_FILENO, SIGIO);
-	if (err)
+	/* Watch stdin for clicks, unless it cannot be polled (e.g. a file) */
+	err = bar_watch(bar, NULL, STDIN_FILENO);
+	if (err == -EPERM)
+		debug("cannot poll stdin, ignoring clicks");
+	else if (err)
 		return err;
 
 	debug("bar set up");
@@ -295,21 +748,37 @@ static void bar_teardown(struct bar *bar)
 	struct block *block = bar->blocks;
 	int err;
 
-	/* Disable event I/O for blocks (persistent) */
+	/* Do not wait for commands in their own process group */
 	while (block) {
-		if (block->interval == INTERVAL_PERSIST) {
-			err = sys_async(block->out[0], 0);
-			if (err)
-				block_error(block, "failed to disable event I/O");
-		}
-
+		block_kill(block);
 		block = block->next;
 	}
 
-	/* Disable event I/O for stdin (clicks) */
-	err = sys_async(STDIN_FILENO, 0);
+	if (bar->epfd >= 0)
+		sys_close(bar->epfd);
+
+	/* Blocks are destroyed after the event loop */
+	bar->epfd = -1;
+
+	if (bar->timerfd >= 0)
+		sys_close(bar->timerfd);
+
+	if (bar->clockfd >= 0)
+		sys_close(bar->clockfd);
+
+	if (bar->sigfd >= 0)
+		sys_close(bar->sigfd);
+
+	/* The spawner waits for its own children once its socket is closed */
+	if (bar->spawner >= 0)
+		sys_close(bar->spawner);
+
+	bar->spawner = -1;
+
+	/* Restore blocking I/O on stdin */
+	err = sys_nonblock(STDIN_FILENO, false);
 	if (err)
-		error("failed to disable event I/O on stdin");
+		error("failed to restore blocking I/O on stdin");
 
 	/*
 	 * Unblock signals (so subsequent syscall can be interrupted)
@@ -326,9 +795,44 @@ static void bar_teardown(struct bar *bar)
 	debug("bar tear down");
 }
 
+/* Return true if the bar must stop */
+static bool bar_poll_signal(struct bar *bar)
+{
+	int sig;
+	int err;
+
+	err = sys_signalfd_read(bar->sigfd, &sig);
+	if (err)
+		return err != -EAGAIN;
+
+	if (sig == SIGTERM || sig == SIGINT)
+		return true;
+
+	if (sig == SIGCHLD) {
+		bar_poll_exited(bar);
+		return false;
+	}
+
+	if (sig > SIGRTMIN && sig <= SIGRTMAX) {
+		bar_poll_signaled(bar, sig - SIGRTMIN);
+		return false;
+	}
+
+	if (sig == SIGUSR1 || sig == SIGUSR2) {
+		error("SIGUSR{1,2} are deprecated, ignoring.");
+		return false;
+	}
+
+	debug("unhandled signal %d", sig);
+
+	return false;
+}
+
 static int bar_poll(struct bar *bar)
 {
-	int sig, fd;
+	struct epoll_event events[64];
+	bool expired, clocked, signaled;
+	int count, fd, i;
 	int err;
 
 	err = bar_setup(bar);
@@ -342,7 +846,11 @@ static int bar_poll(struct bar *bar)
 	bar_poll_timed(bar);
 
 	while (1) {
-		err = sys_sigwaitinfo(&bar->sigset, &sig, &fd);
+		err = bar_schedule(bar);
+		if (err)
+			break;
+
+		err = sys_epoll_wait(bar->epfd, events, 64, &count);
 		if (err) {
 			/* Hiding the bar may interrupt this system call */
 			if (err == -EINTR)
@@ -350,42 +858,46 @@ static int bar_poll(struct bar *bar)
 			break;
 		}
 
-		if (sig == SIGTERM || sig == SIGINT)
-			break;
-
-		if (sig == SIGALRM) {
-			bar_poll_expired(bar);
-			continue;
-		}
+		expired = clocked = signaled = false;
 
-		if (sig == SIGCHLD) {
-			bar_poll_exited(bar);
-			bar_print(bar);
-			continue;
-		}
-
-		if (sig == SIGIO) {
-			bar_read(bar);
-			continue;
+		/*
+		 * Handle block outputs first, so that a descriptor closed
+		 * and reused while handling another event is never stale.
+		 */
+		for (i = 0; i < count; i++) {
+			fd = events[i].data.fd;
+
+			if (fd == bar->timerfd) {
+				expired = true;
+			} else if (fd == bar->clockfd) {
+				clocked = true;
+			} else if (fd == bar->sigfd) {
+				signaled = true;
+			} else if (!(events[i].events & EPOLLIN) &&
+				   fd != bar->spawner) {
+				/* Level-triggered, a bare hang up would spin */
+				debug("descriptor %d hung up", fd);
+				bar_unwatch(bar, fd);
+			} else if (fd == STDIN_FILENO) {
+				bar_read(bar);
+			} else if (fd == bar->spawner) {
+				bar_poll_spawner(bar, events[i].events);
+			} else {
+				bar_poll_readable(bar, fd);
+			}
 		}
 
-		if (sig == SIGRTMIN) {
-			bar_poll_readable(bar, fd);
-			bar_print(bar);
-			continue;
-		}
+		if (expired)
+			bar_poll_expired(bar);
 
-		if (sig > SIGRTMIN && sig <= SIGRTMAX) {
-			bar_poll_signaled(bar, sig - SIGRTMIN);
-			continue;
-		}
+		if (clocked)
+			bar_poll_clocked(bar);
 
-		if (sig == SIGUSR1 || sig == SIGUSR2) {
-			error("SIGUSR{1,2} are deprecated, ignoring.");
-			continue;
-		}
+		if (signaled && bar_poll_signal(bar))
+			break;
 
-		debug("unhandled signal %d", sig);
+		bar_drain(bar);
+		bar_flush(bar);
 	}
 
 	bar_teardown(bar);
@@ -406,10 +918,22 @@ static void bar_destroy(struct bar *bar)
 		block = next;
 	}
 
+	if (bar->timers)
+		heap_destroy(bar->timers);
+
+	if (bar->clocks)
+		heap_destroy(bar->clocks);
+
+	if (bar->queue)
+		heap_destroy(bar->queue);
+
+	free(bar->children);
+	free(bar->fds);
+
 	free(bar);
 }
 
-static struct bar *bar_create(bool term)
+static struct bar *bar_create(bool term, unsigned long frame)
 {
 	struct bar *bar;
 	int err;
@@ -418,6 +942,24 @@ static struct bar *bar_create(bool term)
 	if (!bar)
 		return NULL;
 
+	bar->timers = heap_create();
+	if (!bar->timers) {
+		bar_destroy(bar);
+		return NULL;
+	}
+
+	bar->clocks = heap_create();
+	if (!bar->clocks) {
+		bar_destroy(bar);
+		return NULL;
+	}
+
+	bar->queue = heap_create();
+	if (!bar->queue) {
+		bar_destroy(bar);
+		return NULL;
+	}
+
 	bar->blocks = block_create(bar, NULL);
 	if (!bar->blocks) {
 		bar_destroy(bar);
@@ -425,6 +967,12 @@ static struct bar *bar_create(bool term)
 	}
 
 	bar->term = term;
+	bar->frame = frame;
+	bar->epfd = -1;
+	bar->sigfd = -1;
+	bar->timerfd = -1;
+	bar->clockfd = -1;
+	bar->spawner = -1;
 
 	err = bar_start(bar);
 	if (err) {
@@ -462,15 +1010,27 @@ static void bar_load(struct bar *bar, const char *path)
 		bar_fatal(bar, "Failed to load configuration file %s", path);
 }
 
-int bar_init(bool term, const char *path)
+int bar_init(bool term, const char *path, unsigned long frame, bool spawner,
+	     unsigned int jobs)
 {
 	struct bar *bar;
 	int err;
 
-	bar = bar_create(term);
+	bar = bar_create(term, frame);
 	if (!bar)
 		return -ENOMEM;
 
+	bar->jobs = jobs;
+
+	/* Fork while the process is still small, before loading blocks */
+	if (spawner) {
+		err = spawner_start(&bar->spawner, &bar->spawner_pid);
+		if (err) {
+			bar_destroy(bar);
+			return err;
+		}
+	}
+
 	bar_load(bar, path);
 
 	err = bar_poll(bar);
@@ -22,12 +22,60 @@
 #include <stdbool.h>
 
 #include "block.h"
+#include "heap.h"
+#include "line.h"
 #include "sys.h"
 
+struct heap;
+
 struct bar {
 	struct block *blocks;
 	sigset_t sigset;
 	bool term;
+
+	/* Event loop */
+	int epfd;
+	int sigfd;
+	int timerfd;
+	int clockfd;
+
+	/* Click events read ahead from stdin */
+	struct line input;
+
+	/* Watched blocks indexed by descriptor */
+	struct block **fds;
+	unsigned int nfds;
+
+	/* Timed blocks ordered by their next update */
+	struct heap *timers;
+	unsigned long long alarm;
+
+	/* Wall-clock blocks ordered by their next update (real time) */
+	struct heap *clocks;
+	unsigned long long clockalarm;
+
+	/* Rendering, at most once per frame (in milliseconds) */
+	struct heap_node redraw;
+	unsigned long long rendered;
+	unsigned long frame;
+	bool dirty;
+
+	/* Spawned blocks hashed by PID */
+	struct block **children;
+	unsigned int nchildren;
+
+	/* Timed blocks waiting for one of at most jobs commands to exit */
+	struct heap *queue;
+	unsigned int running;
+	unsigned int jobs;
+
+	/* Optional process spawning commands on behalf of the bar */
+	int spawner;
+	pid_t spawner_pid;
+
+	/* Spawn requests waiting for the spawner socket to be writable */
+	struct block *requests;
+	struct block *last_request;
 };
 
 #define bar_printf(bar, lvl, fmt, ...) \
@@ -57,12 +105,19 @@ struct bar {
 		bar_printf(bar, LOG_DEBUG, "Debug: " fmt, ##__VA_ARGS__); \
 	} while (0)
 
-int bar_init(bool term, const char *path);
+int bar_init(bool term, const char *path, unsigned long frame, bool spawner,
+	     unsigned int jobs);
+int bar_watch(struct bar *bar, struct block *block, int fd);
+void bar_unwatch(struct bar *bar, int fd);
+int bar_request(struct bar *bar, struct block *block);
+void bar_child_add(struct bar *bar, struct block *block);
+void bar_child_del(struct bar *bar, struct block *block);
 
+struct line;
 struct map;
 
 /* i3bar.c */
-int i3bar_read(int fd, size_t count, struct map *map);
+int i3bar_read(int fd, struct line *line, size_t count, struct map *map);
 int i3bar_click(struct bar *bar);
 int i3bar_print(const struct bar *bar);
 int i3bar_printf(struct block *block, int lvl, const char *msg);
@@ -0,0 +1,154 @@
+/*
+ * bench.c - micro-benchmarks of the map and JSON hot paths
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "json.h"
+#include "line.h"
+#include "log.h"
+#include "map.h"
+
+/* Lines written to the pipe at once, they must fit in a line buffer */
+#define JSON_BATCH	32
+
+unsigned int log_level;
+
+static const char *json_sample =
+	"{\"name\":\"cpu\",\"full_text\":\"CPU 12% \\u00e9\","
+	"\"short_text\":\"12%\",\"color\":\"#ff0000\",\"min_width\":120,"
+	"\"urgent\":false,\"separator\":true}\n";
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Cost of a get, and of a set right after clearing, like a block update */
+static int bench_map(int count)
+{
+	const char *volatile value;
+	long iters = 20000000 / count;
+	char (*keys)[32];
+	struct map *map;
+	double t, get, set;
+	long i;
+	int k;
+
+	keys = calloc(count, sizeof(*keys));
+	map = map_create();
+	if (!keys || !map)
+		return -ENOMEM;
+
+	for (k = 0; k < count; k++) {
+		snprintf(keys[k], sizeof(keys[k]), "property_%d", k);
+		if (map_set(map, keys[k], "value"))
+			return -ENOMEM;
+	}
+
+	t = bench_now();
+	for (i = 0; i < iters; i++)
+		for (k = 0; k < count; k++)
+			value = map_get(map, keys[k]);
+	get = (bench_now() - t) / iters / count;
+
+	iters /= 4;
+
+	t = bench_now();
+	for (i = 0; i < iters; i++) {
+		map_clear(map);
+		for (k = 0; k < count; k++)
+			if (map_set(map, keys[k], "value"))
+				return -ENOMEM;
+	}
+	set = (bench_now() - t) / iters / count;
+
+	printf("map, %d keys: get %.1f ns, clear+set %.1f ns per key\n",
+	       count, get, set);
+
+	(void) value;
+	map_destroy(map);
+	free(keys);
+
+	return 0;
+}
+
+/* Cost of parsing one line into a cleared map, like a JSON block update */
+static int bench_json(void)
+{
+	size_t len = strlen(json_sample);
+	char buf[JSON_BATCH * 256];
+	long iters = 2000000 / JSON_BATCH;
+	struct line line;
+	struct map *map;
+	int fds[2];
+	double t;
+	long i;
+	int j;
+
+	if (len * JSON_BATCH > sizeof(line.buf) || pipe(fds))
+		return -EINVAL;
+
+	for (j = 0; j < JSON_BATCH; j++)
+		memcpy(buf + j * len, json_sample, len);
+
+	map = map_create();
+	if (!map)
+		return -ENOMEM;
+
+	line_reset(&line);
+
+	t = bench_now();
+	for (i = 0; i < iters; i++) {
+		if (write(fds[1], buf, len * JSON_BATCH) < 0)
+			return -EIO;
+
+		for (j = 0; j < JSON_BATCH; j++) {
+			map_clear(map);
+			if (json_read(fds[0], &line, 1, map))
+				return -EINVAL;
+		}
+	}
+	t = (bench_now() - t) / iters / JSON_BATCH;
+
+	printf("json, %s: %.0f ns per line\n",
+	       map_get(map, "full_text"), t);
+
+	map_destroy(map);
+	close(fds[0]);
+	close(fds[1]);
+
+	return 0;
+}
+
+int main(void)
+{
+	if (bench_map(20) || bench_map(200) || bench_json()) {
+		fprintf(stderr, "benchmark failed\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
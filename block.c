@@ -25,8 +25,33 @@
 #include "json.h"
 #include "line.h"
 #include "log.h"
+#include "plugin.h"
+#include "spawner.h"
 #include "sys.h"
 
+extern char **environ;
+
+static void block_envp_free(char **envp)
+{
+	char **entry;
+
+	if (!envp)
+		return;
+
+	for (entry = envp; *entry; entry++)
+		free(*entry);
+
+	free(envp);
+}
+
+/* The environment of children is rebuilt on the next spawn */
+static void block_env_changed(struct block *block)
+{
+	block_envp_free(block->envp);
+	block->envp = NULL;
+	block->envstale = true;
+}
+
 const char *block_get(const struct block *block, const char *key)
 {
 	return map_get(block->env, key);
@@ -34,14 +59,24 @@ const char *block_get(const struct block *block, const char *key)
 
 int block_set(struct block *block, const char *key, const char *value)
 {
+	block_env_changed(block);
+
 	return map_set(block->env, key, value);
 }
 
+int block_copy(struct block *block, const struct map *map)
+{
+	block_env_changed(block);
+
+	return map_copy(block->env, map);
+}
+
+/* Drop the properties set by the last update, the config shows through */
 int block_reset(struct block *block)
 {
 	map_clear(block->env);
 
-	return map_copy(block->env, block->config);
+	return 0;
 }
 
 int block_for_each(const struct block *block,
@@ -53,40 +88,160 @@ int block_for_each(const struct block *block,
 
 static bool block_is_spawned(struct block *block)
 {
-	return block->pid > 0;
+	return block->pid != 0;
+}
+
+/* Persistent commands do not count against the concurrency limit */
+static bool block_is_job(struct block *block)
+{
+	return block->interval != INTERVAL_PERSIST;
+}
+
+/* Commands with a timeout lead their own process group, to be killed */
+static bool block_is_watched(struct block *block)
+{
+	return block->timeout > 0 && block->interval != INTERVAL_PERSIST;
+}
+
+/* Legacy env variables, indexed by key id */
+static const char * const block_legacy_env[] = {
+	[KEY_NAME] = "BLOCK_NAME",
+	[KEY_INSTANCE] = "BLOCK_INSTANCE",
+	[KEY_INTERVAL] = "BLOCK_INTERVAL",
+	[KEY_BUTTON] = "BLOCK_BUTTON",
+	[KEY_X] = "BLOCK_X",
+	[KEY_Y] = "BLOCK_Y",
+};
+
+static const char *block_legacy_name(const char *key)
+{
+	enum key id = map_key_id(key);
+
+	if (id >= sizeof(block_legacy_env) / sizeof(block_legacy_env[0]))
+		return NULL;
+
+	return block_legacy_env[id];
+}
+
+static const char *block_legacy_key(const char *name)
+{
+	unsigned int i;
+
+	if (strncmp(name, "BLOCK_", 6) != 0)
+		return NULL;
+
+	for (i = 0; i < sizeof(block_legacy_env) / sizeof(block_legacy_env[0]); i++)
+		if (block_legacy_env[i] && strcmp(block_legacy_env[i], name) == 0)
+			return key_name(i);
+
+	return NULL;
+}
+
+struct block_env {
+	char **envp;
+	size_t len;
+};
+
+static int block_env_add(struct block_env *env, const char *name,
+			 const char *value)
+{
+	size_t size = strlen(name) + strlen(value) + 2;
+	char *str;
+
+	str = malloc(size);
+	if (!str)
+		return -ENOMEM;
+
+	snprintf(str, size, "%s=%s", name, value);
+	env->envp[env->len++] = str;
+
+	return 0;
 }
 
-static int block_setenv(const char *name, const char *value, void *data)
+static int block_env_pair(const char *key, const char *value, void *data)
 {
+	const char *legacy = block_legacy_name(key);
+	struct block_env *env = data;
 	int err;
 
 	if (!value)
 		value = "";
 
-	err = sys_setenv(name, value);
+	err = block_env_add(env, key, value);
 	if (err)
 		return err;
 
-	/* Legacy env variables */
-	if (strcmp(name, "name") == 0)
-		return sys_setenv("BLOCK_NAME", value);
-	if (strcmp(name, "instance") == 0)
-		return sys_setenv("BLOCK_INSTANCE", value);
-	if (strcmp(name, "interval") == 0)
-		return sys_setenv("BLOCK_INTERVAL", value);
-	if (strcmp(name, "button") == 0)
-		return sys_setenv("BLOCK_BUTTON", value);
-	if (strcmp(name, "x") == 0)
-		return sys_setenv("BLOCK_X", value);
-	if (strcmp(name, "y") == 0)
-		return sys_setenv("BLOCK_Y", value);
+	if (legacy)
+		return block_env_add(env, legacy, value);
+
+	return 0;
+}
+
+static int block_env_count(const char *key, const char *value, void *data)
+{
+	size_t *count = data;
+
+	/* Account for a legacy variable as well */
+	*count += 2;
 
 	return 0;
 }
 
-static int block_child_env(struct block *block)
+/* Return true if a NAME=value entry is overridden by the block properties */
+static bool block_env_overrides(const struct block *block, const char *entry)
+{
+	const char *equals = strchr(entry, '=');
+	size_t len = equals ? equals - entry : strlen(entry);
+	char name[len + 1];
+	const char *key;
+
+	memcpy(name, entry, len);
+	name[len] = '\0';
+
+	key = block_legacy_key(name);
+	if (key && block_get(block, key))
+		return true;
+
+	return block_get(block, name) != NULL;
+}
+
+/* Build the environment of a child, inherited and block variables */
+static char **block_envp(const struct block *block)
 {
-	return block_for_each(block, block_setenv, NULL);
+	struct block_env env = { 0 };
+	size_t count = 1;
+	char **entry;
+	int err;
+
+	for (entry = environ; *entry; entry++)
+		count++;
+
+	block_for_each(block, block_env_count, &count);
+
+	env.envp = calloc(count, sizeof(char *));
+	if (!env.envp)
+		return NULL;
+
+	for (entry = environ; *entry; entry++) {
+		if (block_env_overrides(block, *entry))
+			continue;
+
+		env.envp[env.len] = strdup(*entry);
+		if (!env.envp[env.len]) {
+			block_envp_free(env.envp);
+			return NULL;
+		}
+
+		env.len++;
+	}
+
+	err = block_for_each(block, block_env_pair, &env);
+	if (err) {
+		block_envp_free(env.envp);
+		return NULL;
+	}
+
+	return env.envp;
 }
 
 static int block_stdout(struct block *block)
@@ -97,15 +252,25 @@ static int block_stdout(struct block *block)
 	size_t count;
 	int err;
 
-	if (block->interval == INTERVAL_PERSIST)
+	if (block->interval == INTERVAL_PERSIST) {
+		/* Skip intermediate states, only the latest line matters */
+		err = line_drain(out, &block->line);
+		if (err)
+			return err;
+
 		count = 1;
-	else
+	} else {
 		count = -1; /* SIZE_MAX */
+	}
 
-	if (block->format == FORMAT_JSON)
-		err = json_read(out, count, block->env);
+	if (block->plugin)
+		err = plugin_update(block);
+	else if (block->builtin)
+		err = block->builtin(block, block->builtin_arg);
+	else if (block->format == FORMAT_JSON)
+		err = json_read(out, &block->line, count, block->env);
 	else
-		err = i3bar_read(out, count, block->env);
+		err = i3bar_read(out, &block->line, count, block->env);
 
 	if (err && err != -EAGAIN)
 		return err;
@@ -123,7 +288,49 @@ static int block_stdout(struct block *block)
 	return 0;
 }
 
-int block_update(struct block *block)
+/* FNV-1a, null bytes included to separate keys and values */
+static void block_hash_str(uint64_t *hash, const char *str)
+{
+	do {
+		*hash ^= (unsigned char) *str;
+		*hash *= 0x100000001b3ULL;
+	} while (*str++);
+}
+
+static int block_hash_pair(const char *key, const char *value, void *data)
+{
+	uint64_t *hash = data;
+
+	block_hash_str(hash, key);
+	block_hash_str(hash, value ? : "");
+
+	return 0;
+}
+
+static uint64_t block_hash(const struct block *block)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	block_for_each(block, block_hash_pair, &hash);
+
+	return hash;
+}
+
+/* Reuse the environment of the previous spawn until the properties change */
+static int block_env_prepare(struct block *block)
+{
+	if (block->envp && !block->envstale)
+		return 0;
+
+	block_envp_free(block->envp);
+	block->envp = block_envp(block);
+	if (!block->envp)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static int block_refill(struct block *block)
 {
 	int err;
 
@@ -143,6 +350,50 @@ int block_update(struct block *block)
 			return err;
 	}
 
+	return 0;
+}
+
+int block_update(struct block *block)
+{
+	char **envp = block->envp;
+	uint64_t hash;
+	int err;
+
+	/* Set the environment aside, unless written since the last update */
+	block->envp = NULL;
+	if (block->envstale) {
+		block_envp_free(envp);
+		envp = NULL;
+	}
+
+	block->envstale = true;
+
+	err = block_refill(block);
+	if (err) {
+		block_envp_free(envp);
+		return err;
+	}
+
+	hash = block_hash(block);
+
+	/* The environment only needs a rebuild if the properties changed */
+	if (hash == block->hash)
+		block->envp = envp;
+	else
+		block_envp_free(envp);
+
+	block->envstale = false;
+
+	/* Only render again if something changed (or was messed up by errors) */
+	if (hash == block->hash && !block->tainted) {
+		block_debug(block, "unchanged");
+		return 0;
+	}
+
+	block->hash = hash;
+	block->dirty = true;
+	block->bar->dirty = true;
+
 	block_debug(block, "updated successfully");
 
 	return 0;
@@ -203,22 +454,76 @@ static int block_send(struct block *block)
 
 int block_click(struct block *block)
 {
+	int err;
+
 	block_debug(block, "clicked");
 
+	if (block->plugin) {
+		err = plugin_click(block);
+		if (err)
+			block_error(block, "failed to handle click");
+	}
+
 	if (block->interval == INTERVAL_PERSIST)
 		return block_send(block);
 
 	return block_spawn(block);
 }
 
+/* Wall-clock blocks have real time deadlines */
+static struct heap *block_timers(struct block *block)
+{
+	return block->wallclock ? block->bar->clocks : block->bar->timers;
+}
+
+/* Queue the next update of a timed block */
+int block_schedule(struct block *block)
+{
+	unsigned long long next, now;
+	long long gmtoff;
+	int err;
+
+	if (block->interval <= 0)
+		return 0;
+
+	if (block->wallclock) {
+		err = sys_getrealtime(&now, &gmtoff);
+		if (err)
+			return err;
+
+		/*
+		 * Boundaries of the local time, e.g. the top of the hour.
+		 * Setting the clock cancels the timer, but a timezone (or DST)
+		 * change does not: it applies from the next deadline on.
+		 */
+		now += gmtoff;
+		next = now + block->interval;
+		next -= (next - (block->offset > 0 ? block->offset : 0)) %
+			block->interval;
+
+		return heap_update(block->bar->clocks, &block->timer,
+				   next - gmtoff);
+	}
+
+	next = block->timestamp + block->interval;
+
+	/* Snap to the next point of the grid shifted by the phase offset */
+	if (block->offset >= 0)
+		next -= (block->timestamp + block->interval - block->offset) %
+			block->interval;
+
+	return heap_update(block->bar->timers, &block->timer, next);
+}
+
 void block_touch(struct block *block)
 {
-	unsigned long now;
+	unsigned long long now;
 	int err;
 
 	err = sys_gettime(&now);
 	if (err) {
 		block_error(block, "failed to touch block");
+		heap_remove(block_timers(block), &block->timer);
 		return;
 	}
 
@@ -228,161 +533,319 @@ void block_touch(struct block *block)
 	}
 
 	block->timestamp = now;
+
+	err = block_schedule(block);
+	if (err)
+		block_error(block, "failed to schedule block");
 }
 
-static int block_child_sig(struct block *block)
+static int block_parent_stdin(struct block *block)
 {
-	sigset_t set;
-	int err;
+	/* Close read end of stdin pipe */
+	if (block->interval == INTERVAL_PERSIST)
+		return sys_close(block->in[0]);
 
-	/* It'd be safe to assume that all signals are unblocked by default */
-	err = sys_sigfillset(&set);
-	if (err)
-		return err;
+	return 0;
+}
 
-	return sys_sigunblock(&set);
+static int block_parent_stdout(struct block *block)
+{
+	/* Close write end of stdout pipe */
+	return sys_close(block->out[1]);
 }
 
-static int block_child_stdin(struct block *block)
+static int block_parent(struct block *block)
 {
 	int err;
 
-	if (block->interval == INTERVAL_PERSIST) {
-		err = sys_close(block->in[1]);
-		if (err)
-			return err;
-	} else {
-		err = sys_open("/dev/null", &block->in[0]);
-		if (err)
-			return err;
-	}
+	err = block_parent_stdin(block);
+	if (err)
+		return err;
 
-	err = sys_dup(block->in[0], STDIN_FILENO);
+	err = block_parent_stdout(block);
 	if (err)
 		return err;
 
-	return sys_close(block->in[0]);
+	bar_child_add(block->bar, block);
+
+	block_debug(block, "forked child %d", block->pid);
+
+	return 0;
 }
 
-static int block_child_stdout(struct block *block)
+static int block_fork(struct block *block)
 {
+	int in = -1; /* /dev/null */
 	int err;
 
-	err = sys_close(block->out[0]);
+	err = block_env_prepare(block);
 	if (err)
 		return err;
 
-	err = sys_dup(block->out[1], STDOUT_FILENO);
+	if (block->interval == INTERVAL_PERSIST)
+		in = block->in[0];
+
+	err = sys_forkexec(block->argv, block->envp, in, block->out[1],
+			   block_is_watched(block), &block->pid);
 	if (err)
 		return err;
 
-	return sys_close(block->out[1]);
+	return block_parent(block);
 }
 
-static int block_child_exec(struct block *block)
+static int block_spawnvp(struct block *block)
 {
-	return sys_execsh(block->command);
+	int in = -1; /* /dev/null */
+	int err;
+
+	err = block_env_prepare(block);
+	if (err)
+		return err;
+
+	if (block->interval == INTERVAL_PERSIST)
+		in = block->in[0];
+
+	err = sys_spawn(block->argv, block->envp, in, block->out[1],
+			block_is_watched(block), &block->pid);
+	if (err)
+		return err;
+
+	return block_parent(block);
 }
 
-static int block_child(struct block *block)
+/* Send a spawn request, -EAGAIN if the spawner cannot take it yet */
+int block_request_send(struct block *block)
 {
+	int in = -1; /* /dev/null */
 	int err;
 
-	err = block_child_env(block);
+	/* The properties may have changed while the request was queued */
+	err = block_env_prepare(block);
 	if (err)
 		return err;
 
-	err = block_child_sig(block);
+	if (block->interval == INTERVAL_PERSIST)
+		in = block->in[0];
+
+	err = spawner_spawn(block->bar->spawner, (uintptr_t) block,
+			    block->argv, block->envp, in, block->out[1],
+			    block_is_watched(block));
 	if (err)
 		return err;
 
-	err = block_child_stdin(block);
+	block->unsent = false;
+
+	/* The spawner received its own copies of the child ends */
+	err = block_parent_stdin(block);
 	if (err)
 		return err;
 
-	err = block_child_stdout(block);
+	err = block_parent_stdout(block);
 	if (err)
 		return err;
 
-	return block_child_exec(block);
-}
-
-static int block_parent_stdin(struct block *block)
-{
-	/* Close read end of stdin pipe */
-	if (block->interval == INTERVAL_PERSIST)
-		return sys_close(block->in[0]);
+	block_debug(block, "requested spawn");
 
 	return 0;
 }
 
-static int block_parent_stdout(struct block *block)
+/* Hand the command over to the spawner process, see block_spawned() */
+static int block_request(struct block *block)
 {
+	struct bar *bar = block->bar;
 	int err;
 
-	/* Close write end of stdout pipe */
-	err = sys_close(block->out[1]);
-	if (err)
-		return err;
+	/* Stay behind the requests queued already */
+	if (!bar->requests) {
+		err = block_request_send(block);
+		if (err != -EAGAIN) {
+			if (!err)
+				block->pid = -1;
+			return err;
+		}
+	}
 
-	if (block->interval == INTERVAL_PERSIST)
-		return sys_async(block->out[0], SIGRTMIN);
+	block->unsent = true;
+	block->pid = -1;
 
-	return 0;
+	return bar_request(bar, block);
 }
 
-static int block_parent(struct block *block)
+static int block_open(struct block *block)
 {
 	int err;
 
-	err = block_parent_stdin(block);
+	err = sys_pipe(block->out);
 	if (err)
 		return err;
 
-	err = block_parent_stdout(block);
+	/* Do not leak the parent ends into children */
+	err = sys_cloexec(block->out[0]);
 	if (err)
 		return err;
 
-	block_debug(block, "forked child %d", block->pid);
+	line_reset(&block->line);
+
+	if (block->interval == INTERVAL_PERSIST) {
+		err = sys_pipe(block->in);
+		if (err)
+			return err;
+
+		err = sys_cloexec(block->in[1]);
+		if (err)
+			return err;
+
+		/* Dispatch readiness of the output directly to this block */
+		return bar_watch(block->bar, block, block->out[0]);
+	}
 
 	return 0;
 }
 
-static int block_fork(struct block *block)
+/* Release all pipe ends of a command which failed to spawn */
+static void block_discard(struct block *block)
 {
 	int err;
 
-	err = sys_fork(&block->pid);
+	err = sys_close(block->out[1]);
 	if (err)
-		return err;
+		block_error(block, "failed to close stdout");
 
-	if (block->pid == 0) {
-		err = block_child(block);
+	if (block->interval == INTERVAL_PERSIST) {
+		err = sys_close(block->in[0]);
 		if (err)
-			sys_exit(EXIT_ERR_INTERNAL);
+			block_error(block, "failed to close stdin");
 	}
 
-	return block_parent(block);
+	block_close(block);
 }
 
-static int block_open(struct block *block)
+/* Kill the command if it is still running once its timeout expires */
+static int block_watch(struct block *block)
 {
+	unsigned long long now;
 	int err;
 
-	err = sys_pipe(block->out);
+	if (!block_is_watched(block))
+		return 0;
+
+	err = sys_gettime(&now);
 	if (err)
 		return err;
 
-	if (block->interval == INTERVAL_PERSIST)
-		return sys_pipe(block->in);
+	block->terminated = false;
 
-	return 0;
+	return heap_update(block->bar->timers, &block->watchdog,
+			   now + block->timeout);
+}
+
+/* Terminate a hung command, then kill it if it does not exit in time */
+void block_expire(struct block *block)
+{
+	struct heap *timers = block->bar->timers;
+	unsigned long long now;
+	int sig = SIGTERM;
+	int err;
+
+	err = sys_gettime(&now);
+	if (err) {
+		heap_remove(timers, &block->watchdog);
+		return;
+	}
+
+	/* Still waiting for the spawner, check again later */
+	if (block->pid < 0) {
+		heap_update(timers, &block->watchdog, now + BLOCK_KILL_DELAY);
+		return;
+	}
+
+	if (block->terminated)
+		sig = SIGKILL;
+
+	block_debug(block, "timed out, sending signal %d", sig);
+
+	err = sys_kill(-block->pid, sig);
+	if (err || sig == SIGKILL) {
+		heap_remove(timers, &block->watchdog);
+	} else {
+		block->terminated = true;
+		heap_update(timers, &block->watchdog, now + BLOCK_KILL_DELAY);
+	}
+}
+
+/* Kill a command with a timeout, which does not get the signals of the bar */
+void block_kill(struct block *block)
+{
+	if (block->pid > 0 && block_is_watched(block))
+		sys_kill(-block->pid, SIGKILL);
+}
+
+/* Forget a command the bar can no longer wait for, without reading it */
+void block_abandon(struct block *block)
+{
+	/* Only watched commands lead their own process group */
+	if (block_is_watched(block))
+		sys_kill(-block->pid, SIGKILL);
+	else
+		sys_kill(block->pid, SIGKILL);
+
+	block->code = EXIT_ERR_INTERNAL;
+	block->terminated = false;
+	block_exit(block);
+
+	/* The orphan may still hold its end of the pipes open */
+	block_close(block);
+}
+
+/* Report commands executed directly like the shell would */
+static int block_spawn_error(struct block *block, int err)
+{
+	switch (err) {
+	case -ENOENT:
+		block_error(block, "Command '%s' not found or missing dependency",
+			    block->command);
+		return 0;
+	case -EACCES:
+		block_error(block, "Command '%s' not executable",
+			    block->command);
+		return 0;
+	default:
+		block_error(block, "failed to spawn command '%s'",
+			    block->command);
+		return err;
+	}
+}
+
+/* Update a persistent output or a plugin waiting for a descriptor */
+int block_readable(struct block *block, int fd)
+{
+	int err;
+
+	if (block->plugin) {
+		err = plugin_readable(block, fd);
+		if (err)
+			block_error(block, "failed to handle descriptor %d", fd);
+	}
+
+	return block_update(block);
 }
 
 int block_spawn(struct block *block)
 {
 	int err;
 
+	if (block->plugin || block->builtin) {
+		/* Update in-process, there is no child to wait for */
+		block->code = 0;
+
+		err = block_update(block);
+		if (err)
+			block_error(block, "failed to update %s",
+				    block->command ? : "plugin");
+
+		return 0;
+	}
+
 	if (!block->command) {
 		block_debug(block, "no command, skipping");
 		return 0;
@@ -397,31 +860,60 @@ int block_spawn(struct block *block)
 	if (err)
 		return err;
 
-	return block_fork(block);
+	if (block->bar->spawner >= 0) {
+		err = block_request(block);
+	} else {
+		/* Fallback to fork if posix_spawn is not available */
+		err = block_spawnvp(block);
+		if (err == -ENOSYS)
+			err = block_fork(block);
+	}
+	if (err) {
+		block_discard(block);
+		return block_spawn_error(block, err);
+	}
+
+	if (block_is_job(block))
+		block->bar->running++;
+
+	return block_watch(block);
 }
 
-static int block_wait(struct block *block)
+/* Complete a spawn requested to the spawner process */
+void block_spawned(struct block *block, pid_t pid, int err)
 {
-	int err;
+	if (err) {
+		if (block_is_job(block))
+			block->bar->running--;
 
-	if (block->pid <= 0) {
-		block_debug(block, "not spawned yet");
-		return -EAGAIN;
-	}
+		block->pid = 0;
 
-	err = sys_waitpid(block->pid, &block->code);
-	if (err)
-		return err;
+		/* A request never sent still holds the child ends */
+		if (block->unsent) {
+			block->unsent = false;
+			block_discard(block);
+		} else {
+			block_close(block);
+		}
 
-	block_debug(block, "process %d exited with %d", block->pid, block->code);
+		block_spawn_error(block, err);
+		return;
+	}
 
-	/* Process successfully reaped, reset the block PID */
-	block->pid = 0;
+	block->pid = pid;
+	bar_child_add(block->bar, block);
 
-	if (block->code == EXIT_ERR_INTERNAL)
-		return -ECHILD;
+	block_debug(block, "spawned child %d", block->pid);
+}
 
-	return 0;
+static int block_wait(struct block *block)
+{
+	if (block->pid <= 0) {
+		block_debug(block, "not spawned yet");
+		return -EAGAIN;
+	}
+
+	return sys_waitpid(block->pid, &block->code);
 }
 
 void block_close(struct block *block)
@@ -435,6 +927,8 @@ void block_close(struct block *block)
 			block_error(block, "failed to close stdin");
 
 		block->in[1] = -1;
+
+		bar_unwatch(block->bar, block->out[0]);
 	}
 
 	err = sys_close(block->out[0]);
@@ -457,7 +951,34 @@ int block_reap(struct block *block)
 		return err;
 	}
 
+	return block_exit(block);
+}
+
+/* Account for the exit code of a reaped process */
+int block_exit(struct block *block)
+{
+	block_debug(block, "process %d exited with %d", block->pid, block->code);
+
+	/* Process successfully reaped, reset the block PID */
+	bar_child_del(block->bar, block);
+	block->pid = 0;
+
+	if (block_is_job(block))
+		block->bar->running--;
+
+	heap_remove(block->bar->timers, &block->watchdog);
+
+	/* The exit code is meaningless after a signal */
+	if (block->terminated) {
+		block->terminated = false;
+		block_error(block, "Command '%s' timed out", block->command);
+		return -ETIME;
+	}
+
 	switch (block->code) {
+	case EXIT_ERR_INTERNAL:
+		block_error(block, "Internal error");
+		return -ECHILD;
 	case 0:
 	case EXIT_URGENT:
 		break;
@@ -478,13 +999,163 @@ int block_reap(struct block *block)
 	return 0;
 }
 
+/* Parse a duration such as "5", "1.5s" or "250ms" into milliseconds */
+static int i3blocks_duration(const char *value, long long *msec)
+{
+	unsigned long long sec, frac = 0;
+	unsigned int digits = 0;
+	const char *end = value;
+
+	if (!isdigit(*end))
+		return -EINVAL;
+
+	for (sec = 0; isdigit(*end); end++)
+		sec = sec * 10 + *end - '0';
+
+	if (*end == '.') {
+		for (end++; isdigit(*end); end++) {
+			if (digits < 3) {
+				frac = frac * 10 + *end - '0';
+				digits++;
+			}
+		}
+
+		/* Fractional seconds only */
+		if (strcmp(end, "ms") == 0)
+			return -EINVAL;
+	}
+
+	while (digits++ < 3)
+		frac *= 10;
+
+	if (strcmp(end, "ms") == 0)
+		*msec = sec;
+	else if (*end == '\0' || strcmp(end, "s") == 0)
+		*msec = sec * 1000 + frac;
+	else
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Reserved words and builtins only a shell can execute */
+static const char * const i3blocks_shell_words[] = {
+	"!", ".", ":", "[", "alias", "bg", "break", "case", "cd", "command",
+	"continue", "do", "done", "echo", "elif", "else", "esac", "eval",
+	"exec", "exit", "export", "false", "fc", "fg", "fi", "for", "getopts",
+	"hash", "if", "jobs", "kill", "local", "printf", "pwd", "read",
+	"readonly", "return", "set", "shift", "test", "then", "times", "trap",
+	"true", "type", "ulimit", "umask", "unalias", "unset", "until", "wait",
+	"while",
+};
+
+static bool i3blocks_needs_shell(const char *command)
+{
+	size_t len;
+	int i;
+
+	/* Quoting, expansions, redirections, control operators, etc. */
+	if (strpbrk(command, "|&;<>()$`\\\"'*?[]#~{}!\n"))
+		return true;
+
+	command += strspn(command, " \t");
+	len = strcspn(command, " \t");
+
+	/* Nothing to execute or variable assignments */
+	if (!len || memchr(command, '=', len))
+		return true;
+
+	for (i = 0; i < sizeof(i3blocks_shell_words) / sizeof(i3blocks_shell_words[0]); i++)
+		if (strlen(i3blocks_shell_words[i]) == len &&
+		    strncmp(i3blocks_shell_words[i], command, len) == 0)
+			return true;
+
+	return false;
+}
+
+/* Resolve "@name [arg]" commands implemented by i3blocks itself */
+static int i3blocks_builtin(struct block *block)
+{
+	const char *name = block->command + 1;
+	size_t len = strcspn(name, " \t");
+	const char *arg = name + len;
+
+	block->builtin = builtin_lookup(name, len);
+	if (!block->builtin) {
+		block_error(block, "unknown built-in '%s'", block->command);
+		return -EINVAL;
+	}
+
+	/* Built-ins have no process to keep running */
+	if (block->interval == INTERVAL_REPEAT ||
+	    block->interval == INTERVAL_PERSIST) {
+		block_error(block, "built-in '%s' requires a timed interval",
+			    block->command);
+		return -EINVAL;
+	}
+
+	arg += strspn(arg, " \t");
+	if (*arg != '\0')
+		block->builtin_arg = arg;
+
+	block_debug(block, "built-in %.*s", (int) len, name);
+
+	return 0;
+}
+
+/* Split the command once, unless it must be interpreted by /bin/sh -c */
+static int i3blocks_argv(struct block *block)
+{
+	const char *value = map_get(block->config, "shell");
+	size_t argc = 0;
+	bool shell;
+	char *arg;
+
+	if (value && strcmp(value, "true") == 0)
+		shell = true;
+	else if (value && strcmp(value, "false") == 0)
+		shell = false;
+	else
+		shell = i3blocks_needs_shell(block->command);
+
+	if (!shell) {
+		block->args = strdup(block->command);
+		if (!block->args)
+			return -ENOMEM;
+
+		/* At most one argument every two characters */
+		block->argv = calloc(strlen(block->args) / 2 + 2,
+				     sizeof(char *));
+		if (!block->argv)
+			return -ENOMEM;
+
+		for (arg = strtok(block->args, " \t"); arg;
+		     arg = strtok(NULL, " \t"))
+			block->argv[argc++] = arg;
+
+		if (argc) {
+			block_debug(block, "executing %s directly", block->argv[0]);
+			return 0;
+		}
+
+		free(block->argv);
+	}
+
+	block->argv = calloc(4, sizeof(char *));
+	if (!block->argv)
+		return -ENOMEM;
+
+	block->argv[0] = "/bin/sh";
+	block->argv[1] = "-c";
+	block->argv[2] = (char *) block->command;
+
+	return 0;
+}
+
 static int i3blocks_setup(struct block *block)
 {
 	const char *value;
-
-	value = map_get(block->config, "command");
-	if (value && *value != '\0')
-		block->command = value;
+	int err;
 
 	value = map_get(block->config, "interval");
 	if (!value)
@@ -495,8 +1166,54 @@ static int i3blocks_setup(struct block *block)
 		block->interval = INTERVAL_REPEAT;
 	else if (strcmp(value, "persist") == 0)
 		block->interval = INTERVAL_PERSIST;
-	else
+	else if (*value == '-')
 		block->interval = atoi(value);
+	else {
+		err = i3blocks_duration(value, &block->interval);
+		if (err) {
+			block_error(block, "invalid interval \"%s\"", value);
+			return err;
+		}
+	}
+
+	value = map_get(block->config, "timeout");
+	if (!value) {
+		block->timeout = 0;
+	} else {
+		err = i3blocks_duration(value, &block->timeout);
+		if (err) {
+			block_error(block, "invalid timeout \"%s\"", value);
+			return err;
+		}
+	}
+
+	value = map_get(block->config, "wallclock");
+	block->wallclock = value && strcmp(value, "true") == 0 &&
+			   block->interval > 0;
+
+	/*
+	 * Untimed blocks ignore a global offset, and wall-clock blocks an
+	 * automatic one, which would move them off the boundaries.
+	 */
+	value = map_get(block->config, "offset");
+	if (!value || block->interval <= 0 ||
+	    (block->wallclock && strcmp(value, "auto") == 0)) {
+		block->offset = -1;
+	} else if (strcmp(value, "auto") == 0) {
+		uint64_t hash = 0xcbf29ce484222325ULL;
+
+		/* The pretty name is "name:instance", hash it as a whole */
+		block_hash_str(&hash, block->name);
+		block->offset = hash % block->interval;
+	} else {
+		err = i3blocks_duration(value, &block->offset);
+		if (err) {
+			block_error(block, "invalid offset \"%s\"", value);
+			return err;
+		}
+
+		block->offset %= block->interval;
+	}
 
 	value = map_get(block->config, "format");
 	if (value && strcmp(value, "json") == 0)
@@ -510,6 +1227,35 @@ static int i3blocks_setup(struct block *block)
 	else
 		block->signal = atoi(value);
 
+	value = map_get(block->config, "plugin");
+	if (value && *value != '\0') {
+		if (map_get(block->config, "command")) {
+			block_error(block, "plugin and command are exclusive");
+			return -EINVAL;
+		}
+
+		/* Plugins run in-process, like built-ins */
+		if (block->interval == INTERVAL_REPEAT ||
+		    block->interval == INTERVAL_PERSIST) {
+			block_error(block, "plugin requires a timed interval");
+			return -EINVAL;
+		}
+
+		return plugin_load(block, value);
+	}
+
+	value = map_get(block->config, "command");
+	if (value && *value != '\0') {
+		block->command = value;
+
+		if (*value == '@')
+			err = i3blocks_builtin(block);
+		else
+			err = i3blocks_argv(block);
+		if (err)
+			return err;
+	}
+
 	return 0;
 }
 
@@ -521,14 +1267,17 @@ int block_setup(struct block *block)
 	if (err)
 		return err;
 
-	err = i3blocks_setup(block);
+	/* Plugins may read their properties on initialization */
+	err = block_reset(block);
 	if (err)
 		return err;
 
-	err = block_reset(block);
+	err = i3blocks_setup(block);
 	if (err)
 		return err;
 
+	block->dirty = true;
+
 	block_debug(block, "new block");
 
 	return 0;
@@ -536,8 +1285,24 @@ int block_setup(struct block *block)
 
 void block_destroy(struct block *block)
 {
-	map_destroy(block->config);
+	if (block_timers(block))
+		heap_remove(block_timers(block), &block->timer);
+
+	if (block->bar->timers)
+		heap_remove(block->bar->timers, &block->watchdog);
+
+	if (block->bar->queue)
+		heap_remove(block->bar->queue, &block->queued);
+
+	plugin_unload(block);
+
 	map_destroy(block->env);
+	map_destroy(block->config);
+	free(block->json);
+	block_envp_free(block->envp);
+	free(block->argv);
+	free(block->args);
+	free(block->builtin_data);
 	free(block->name);
 	free(block);
 }
@@ -552,6 +1317,9 @@ struct block *block_create(struct bar *bar, const struct map *config)
 		return NULL;
 
 	block->bar = bar;
+	block->timer.data = block;
+	block->watchdog.data = block;
+	block->queued.data = block;
 
 	block->config = map_create();
 	if (!block->config) {
@@ -567,7 +1335,7 @@ struct block *block_create(struct bar *bar, const struct map *config)
 		}
 	}
 
-	block->env = map_create();
+	block->env = map_overlay(block->config);
 	if (!block->env) {
 		block_destroy(block);
 		return NULL;
@@ -19,9 +19,14 @@
 #ifndef BLOCK_H
 #define BLOCK_H
 
+#include <stdint.h>
 #include <sys/types.h>
 
 #include "bar.h"
+#include "builtin.h"
+#include "heap.h"
+#include "i3blocks.h"
+#include "line.h"
 #include "log.h"
 #include "map.h"
 
@@ -34,31 +39,64 @@
 
 /* Block command exit codes */
 #define EXIT_URGENT	'!' /* 33 */
-#define EXIT_ERR_INTERNAL	66
+
+/* Delay between terminating and killing a timed out command (ms) */
+#define BLOCK_KILL_DELAY	1000
 
 struct block {
-	const struct bar *bar;
+	struct bar *bar;
 
 	struct map *config;
 	struct map *env;
 
 	bool tainted;
+	bool dirty;
+
+	/* Digest of the properties as last updated */
+	uint64_t hash;
+
+	/* Serialized i3bar object, regenerated when dirty */
+	char *json;
+	size_t jsonlen;
+
+	/* Environment of children, dropped when the properties change */
+	char **envp;
+	bool envstale;
 
 	/* Pretty name for log messages */
 	char *name;
 
 	/* Shortcuts */
 	const char *command;
-	int interval;
+	char **argv;
+	char *args;
+	builtin_func_t *builtin;
+	const char *builtin_arg;
+	void *builtin_data;
+	const struct i3blocks_plugin *plugin;
+	void *plugin_handle;
+	void *plugin_data;
+	long long interval; /* milliseconds */
+	long long timeout; /* milliseconds */
+	long long offset; /* milliseconds, -1 if unphased */
+	bool wallclock;
 	int signal;
 	unsigned format;
 
 	/* Runtime info */
-	unsigned long timestamp;
+	unsigned long long timestamp;
+	struct heap_node timer;
+	struct heap_node watchdog;
+	bool terminated;
+	struct heap_node queued;
 	int in[2];
 	int out[2];
+	struct line line;
 	int code;
-	pid_t pid;
+	pid_t pid; /* -1 while the spawner is starting it */
+	bool unsent; /* request still queued by the bar */
+	struct block *next_request;
+	struct block *next_child;
 
 	struct block *next;
 };
@@ -67,9 +105,11 @@ struct block *block_create(struct bar *bar, const struct map *config);
 void block_destroy(struct block *block);
 
 int block_reset(struct block *block);
+int block_readable(struct block *block, int fd);
 
 const char *block_get(const struct block *block, const char *key);
 int block_set(struct block *block, const char *key, const char *value);
+int block_copy(struct block *block, const struct map *map);
 
 int block_for_each(const struct block *block,
 		   int (*func)(const char *key, const char *value, void *data),
@@ -105,7 +145,14 @@ int block_setup(struct block *block);
 int block_click(struct block *block);
 int block_spawn(struct block *block);
 void block_touch(struct block *block);
+int block_schedule(struct block *block);
+int block_request_send(struct block *block);
+void block_expire(struct block *block);
+void block_kill(struct block *block);
+void block_abandon(struct block *block);
 int block_reap(struct block *block);
+int block_exit(struct block *block);
+void block_spawned(struct block *block, pid_t pid, int err);
 int block_update(struct block *block);
 void block_close(struct block *block);
 
@@ -0,0 +1,237 @@
+/*
+ * builtin.c - implementation of built-in blocks
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "block.h"
+#include "builtin.h"
+#include "log.h"
+#include "sys.h"
+
+#define GIB	(1024.0 * 1024.0 * 1024.0)
+
+/* Read a small pseudo file at once */
+static int builtin_read(const char *path, char *buf, size_t size)
+{
+	size_t count = 0;
+	int err, fd;
+
+	err = sys_open(path, &fd);
+	if (err)
+		return err;
+
+	err = sys_read(fd, buf, size - 1, &count);
+	sys_close(fd);
+	if (err && err != -EAGAIN)
+		return err;
+
+	buf[count] = '\0';
+
+	return 0;
+}
+
+static int builtin_time(struct block *block, const char *arg)
+{
+	char buf[BUFSIZ];
+	struct tm tm;
+	time_t now;
+
+	now = time(NULL);
+	if (!localtime_r(&now, &tm))
+		return -EINVAL;
+
+	if (!strftime(buf, sizeof(buf), arg ? : "%Y-%m-%d %H:%M:%S", &tm))
+		return -EINVAL;
+
+	return block_set(block, "full_text", buf);
+}
+
+struct builtin_cpu {
+	unsigned long long total;
+	unsigned long long idle;
+	char text[8];
+};
+
+/* Usage since the previous update, or since boot on the first one */
+static int builtin_cpu(struct block *block, const char *arg)
+{
+	unsigned long long val[8] = { 0 };
+	unsigned long long total = 0, idle, ticks, idled;
+	struct builtin_cpu *cpu;
+	char buf[BUFSIZ];
+	int err, i;
+
+	if (!block->builtin_data) {
+		block->builtin_data = calloc(1, sizeof(struct builtin_cpu));
+		if (!block->builtin_data)
+			return -ENOMEM;
+	}
+
+	cpu = block->builtin_data;
+
+	err = builtin_read("/proc/stat", buf, sizeof(buf));
+	if (err)
+		return err;
+
+	/* user nice system idle iowait irq softirq steal */
+	if (sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+		   &val[0], &val[1], &val[2], &val[3], &val[4], &val[5],
+		   &val[6], &val[7]) < 4)
+		return -EINVAL;
+
+	for (i = 0; i < 8; i++)
+		total += val[i];
+
+	idle = val[3] + val[4];
+
+	/* Without elapsed ticks, show the previous usage again */
+	if (total > cpu->total) {
+		ticks = total - cpu->total;
+
+		/* iowait is known to go backwards on some kernels */
+		idled = idle > cpu->idle ? idle - cpu->idle : 0;
+		if (idled > ticks)
+			idled = ticks;
+
+		snprintf(cpu->text, sizeof(cpu->text), "%.0f%%",
+			 100.0 * (ticks - idled) / ticks);
+
+		cpu->total = total;
+		cpu->idle = idle;
+	}
+
+	return block_set(block, "full_text", cpu->text);
+}
+
+static int builtin_meminfo(const char *buf, const char *key,
+			   unsigned long long *kib)
+{
+	const char *line = strstr(buf, key);
+
+	if (!line || sscanf(line + strlen(key), " %llu kB", kib) != 1)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int builtin_mem(struct block *block, const char *arg)
+{
+	unsigned long long total, avail;
+	char buf[BUFSIZ];
+	int err;
+
+	err = builtin_read("/proc/meminfo", buf, sizeof(buf));
+	if (err)
+		return err;
+
+	err = builtin_meminfo(buf, "MemTotal:", &total);
+	if (err)
+		return err;
+
+	err = builtin_meminfo(buf, "MemAvailable:", &avail);
+	if (err)
+		return err;
+
+	snprintf(buf, sizeof(buf), "%.1fG/%.1fG", (total - avail) * 1024 / GIB,
+		 total * 1024 / GIB);
+
+	return block_set(block, "full_text", buf);
+}
+
+static int builtin_disk(struct block *block, const char *arg)
+{
+	unsigned long long avail, total;
+	char buf[BUFSIZ];
+	int err;
+
+	err = sys_statvfs(arg ? : "/", &avail, &total);
+	if (err)
+		return err;
+
+	snprintf(buf, sizeof(buf), "%.1fG", avail / GIB);
+
+	return block_set(block, "full_text", buf);
+}
+
+static int builtin_battery(struct block *block, const char *arg)
+{
+	const char *supply = arg ? : "BAT0";
+	char path[BUFSIZ];
+	char status[BUFSIZ];
+	char buf[BUFSIZ];
+	int capacity;
+	int err;
+
+	snprintf(path, sizeof(path), "/sys/class/power_supply/%s/capacity",
+		 supply);
+	err = builtin_read(path, buf, sizeof(buf));
+	if (err)
+		return err;
+
+	capacity = atoi(buf);
+
+	snprintf(path, sizeof(path), "/sys/class/power_supply/%s/status",
+		 supply);
+	err = builtin_read(path, status, sizeof(status));
+	if (err)
+		return err;
+
+	status[strcspn(status, "\n")] = '\0';
+
+	if (strcmp(status, "Charging") == 0)
+		snprintf(buf, sizeof(buf), "CHR %d%%", capacity);
+	else if (strcmp(status, "Discharging") == 0)
+		snprintf(buf, sizeof(buf), "DIS %d%%", capacity);
+	else
+		snprintf(buf, sizeof(buf), "%d%%", capacity);
+
+	err = block_set(block, "full_text", buf);
+	if (err)
+		return err;
+
+	if (strcmp(status, "Discharging") == 0 && capacity < 10)
+		return block_set(block, "urgent", "true");
+
+	return 0;
+}
+
+static const struct {
+	const char * const name;
+	builtin_func_t *func;
+} builtins[] = {
+	{ "battery", builtin_battery },
+	{ "cpu", builtin_cpu },
+	{ "disk", builtin_disk },
+	{ "mem", builtin_mem },
+	{ "time", builtin_time },
+};
+
+builtin_func_t *builtin_lookup(const char *name, size_t len)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++)
+		if (strlen(builtins[i].name) == len &&
+		    strncmp(builtins[i].name, name, len) == 0)
+			return builtins[i].func;
+
+	return NULL;
+}
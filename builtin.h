@@ -0,0 +1,31 @@
+/*
+ * builtin.h - definition of built-in blocks
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUILTIN_H
+#define BUILTIN_H
+
+#include <stddef.h>
+
+struct block;
+
+/* Update the block properties in place of a command output */
+typedef int builtin_func_t(struct block *block, const char *arg);
+
+builtin_func_t *builtin_lookup(const char *name, size_t len);
+
+#endif /* BUILTIN_H */
@@ -0,0 +1,170 @@
+/*
+ * heap.c - implementation of a binary min-heap
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "heap.h"
+
+struct heap {
+	/* 1-based array, so that the parent of i is i / 2 */
+	struct heap_node **nodes;
+	size_t len;
+	size_t size;
+};
+
+static void heap_place(struct heap *heap, struct heap_node *node, size_t i)
+{
+	heap->nodes[i] = node;
+	node->index = i;
+}
+
+static void heap_up(struct heap *heap, struct heap_node *node)
+{
+	size_t i = node->index;
+	struct heap_node *parent;
+
+	while (i > 1) {
+		parent = heap->nodes[i / 2];
+		if (parent->key <= node->key)
+			break;
+
+		heap_place(heap, parent, i);
+		i /= 2;
+	}
+
+	heap_place(heap, node, i);
+}
+
+static void heap_down(struct heap *heap, struct heap_node *node)
+{
+	size_t i = node->index;
+	struct heap_node *child;
+	size_t j;
+
+	while ((j = i * 2) <= heap->len) {
+		if (j < heap->len && heap->nodes[j + 1]->key < heap->nodes[j]->key)
+			j++;
+
+		child = heap->nodes[j];
+		if (node->key <= child->key)
+			break;
+
+		heap_place(heap, child, i);
+		i = j;
+	}
+
+	heap_place(heap, node, i);
+}
+
+static int heap_grow(struct heap *heap)
+{
+	struct heap_node **nodes;
+	size_t size;
+
+	size = heap->size ? heap->size * 2 : 16;
+
+	nodes = realloc(heap->nodes, (size + 1) * sizeof(struct heap_node *));
+	if (!nodes)
+		return -ENOMEM;
+
+	heap->nodes = nodes;
+	heap->size = size;
+
+	return 0;
+}
+
+static int heap_insert(struct heap *heap, struct heap_node *node)
+{
+	int err;
+
+	if (heap->len == heap->size) {
+		err = heap_grow(heap);
+		if (err)
+			return err;
+	}
+
+	heap_place(heap, node, ++heap->len);
+	heap_up(heap, node);
+
+	return 0;
+}
+
+/* Queue a node or move it according to its new key */
+int heap_update(struct heap *heap, struct heap_node *node,
+		unsigned long long key)
+{
+	unsigned long long old = node->key;
+
+	node->key = key;
+
+	if (!heap_queued(node))
+		return heap_insert(heap, node);
+
+	if (key < old)
+		heap_up(heap, node);
+	else
+		heap_down(heap, node);
+
+	return 0;
+}
+
+void heap_remove(struct heap *heap, struct heap_node *node)
+{
+	struct heap_node *last;
+	size_t i = node->index;
+
+	if (!heap_queued(node))
+		return;
+
+	last = heap->nodes[heap->len--];
+	node->index = 0;
+
+	if (last == node)
+		return;
+
+	heap_place(heap, last, i);
+	if (i > 1 && heap->nodes[i / 2]->key > last->key)
+		heap_up(heap, last);
+	else
+		heap_down(heap, last);
+}
+
+struct heap_node *heap_peek(const struct heap *heap)
+{
+	if (!heap->len)
+		return NULL;
+
+	return heap->nodes[1];
+}
+
+void heap_destroy(struct heap *heap)
+{
+	size_t i;
+
+	for (i = 1; i <= heap->len; i++)
+		heap->nodes[i]->index = 0;
+
+	free(heap->nodes);
+	free(heap);
+}
+
+struct heap *heap_create(void)
+{
+	return calloc(1, sizeof(struct heap));
+}
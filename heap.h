@@ -0,0 +1,47 @@
+/*
+ * heap.h - definition of a binary min-heap
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A node is embedded in its owner and remembers its position in the heap */
+struct heap_node {
+	unsigned long long key;
+	size_t index; /* 0 when not queued */
+	void *data;
+};
+
+struct heap;
+
+struct heap *heap_create(void);
+void heap_destroy(struct heap *heap);
+
+int heap_update(struct heap *heap, struct heap_node *node,
+		unsigned long long key);
+void heap_remove(struct heap *heap, struct heap_node *node);
+struct heap_node *heap_peek(const struct heap *heap);
+
+static inline bool heap_queued(const struct heap_node *node)
+{
+	return node->index > 0;
+}
+
+#endif /* HEAP_H */
@@ -16,74 +16,64 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
+#include <sys/uio.h>
+
 #include "bar.h"
 #include "block.h"
 #include "json.h"
 #include "line.h"
 #include "log.h"
 #include "map.h"
+#include "sys.h"
 #include "term.h"
 
 /* See https://i3wm.org/docs/i3bar-protocol.html for details */
 
-static struct {
-	const char * const key;
+/* Indexed by key id, in the order of the raw format lines */
+static const struct {
 	bool string;
 } i3bar_keys[] = {
-	{ "", false }, /* unknown key */
+	[KEY_UNKNOWN] = { false },
 
 	/* Standard keys */
-	{ "full_text", true },
-	{ "short_text", true },
-	{ "color", true },
-	{ "background", true },
-	{ "border", true },
-	{ "min_width", false }, /* can also be a number */
-	{ "align", true },
-	{ "name", true },
-	{ "instance", true },
-	{ "urgent", false },
-	{ "separator", false },
-	{ "separator_block_width", false },
-	{ "markup", true },
+	[KEY_FULL_TEXT] = { true },
+	[KEY_SHORT_TEXT] = { true },
+	[KEY_COLOR] = { true },
+	[KEY_BACKGROUND] = { true },
+	[KEY_BORDER] = { true },
+	[KEY_MIN_WIDTH] = { false }, /* can also be a number */
+	[KEY_ALIGN] = { true },
+	[KEY_NAME] = { true },
+	[KEY_INSTANCE] = { true },
+	[KEY_URGENT] = { false },
+	[KEY_SEPARATOR] = { false },
+	[KEY_SEPARATOR_BLOCK_WIDTH] = { false },
+	[KEY_MARKUP] = { true },
 
 	/* i3-gaps features */
-	{ "border_top", false },
-	{ "border_bottom", false },
-	{ "border_left", false },
-	{ "border_right", false },
+	[KEY_BORDER_TOP] = { false },
+	[KEY_BORDER_BOTTOM] = { false },
+	[KEY_BORDER_LEFT] = { false },
+	[KEY_BORDER_RIGHT] = { false },
 };
 
-static unsigned int i3bar_indexof(const char *key)
-{
-	unsigned int i;
-
-	for (i = 0; i < sizeof(i3bar_keys) / sizeof(i3bar_keys[0]); i++)
-		if (strcmp(i3bar_keys[i].key, key) == 0)
-			return i;
-
-	return 0;
-}
-
 static int i3bar_line_cb(char *line, size_t num, void *data)
 {
 	unsigned int index = num + 1;
 	struct map *map = data;
-	const char *key;
 
 	if (index >= sizeof(i3bar_keys) / sizeof(i3bar_keys[0])) {
 		debug("ignoring excess line %d: %s", num, line);
 		return 0;
 	}
 
-	key = i3bar_keys[index].key;
-
-	return map_set(map, key, line);
+	return map_set(map, key_name(index), line);
 }
 
-int i3bar_read(int fd, size_t count, struct map *map)
+int i3bar_read(int fd, struct line *line, size_t count, struct map *map)
 {
-	return line_read(fd, count, i3bar_line_cb, map);
+	return line_read(fd, line, count, i3bar_line_cb, map);
 }
 
 static void i3bar_print_term(const struct bar *bar)
@@ -104,19 +94,26 @@ static void i3bar_print_term(const struct bar *bar)
 	fflush(stdout);
 }
 
+struct i3bar_pairs {
+	FILE *stream;
+	unsigned int count;
+};
+
 static int i3bar_print_pair(const char *key, const char *value, void *data)
 {
-	unsigned int index = i3bar_indexof(key);
-	bool string = i3bar_keys[index].string;
-	unsigned int *pcount = data;
+	enum key id = map_key_id(key);
+	struct i3bar_pairs *pairs = data;
 	char buf[BUFSIZ];
-	bool escape;
+	bool escape, string;
 	int err;
 
 	/* Skip unknown keys */
-	if (!index)
+	if (id == KEY_UNKNOWN ||
+	    id >= sizeof(i3bar_keys) / sizeof(i3bar_keys[0]))
 		return 0;
 
+	string = i3bar_keys[id].string;
+
 	if (!value)
 		value = "null";
 
@@ -140,41 +137,76 @@ static int i3bar_print_pair(const char *key, const char *value, void *data)
 		value = buf;
 	}
 
-	if ((*pcount)++)
-		fprintf(stdout, ",");
+	if (pairs->count++)
+		fprintf(pairs->stream, ",");
 
-	fprintf(stdout, "\"%s\":%s", key, value);
+	fprintf(pairs->stream, "\"%s\":%s", key, value);
 
 	return 0;
 }
 
-static int i3bar_print_block(struct block *block, void *data)
+/* Serialize the JSON object of a block, only if its properties changed */
+static int i3bar_cache_block(struct block *block)
 {
 	const char *full_text = map_get(block->env, "full_text");
-	unsigned int *mcount = data;
-	unsigned int pcount = 0;
+	struct i3bar_pairs pairs = { 0 };
+	size_t len = 0;
+	char *buf = NULL;
 	int err;
 
+	if (!block->dirty)
+		return 0;
+
+	free(block->json);
+	block->json = NULL;
+	block->jsonlen = 0;
+	block->dirty = false;
+
 	/* "full_text" is the only mandatory key */
 	if (!full_text) {
 		block_debug(block, "no text to display, skipping");
 		return 0;
 	}
 
-	if ((*mcount)++)
-		fprintf(stdout, ",");
+	pairs.stream = open_memstream(&buf, &len);
+	if (!pairs.stream)
+		return -ENOMEM;
 
-	fprintf(stdout, "{");
-	err = map_for_each(block->env, i3bar_print_pair, &pcount);
-	fprintf(stdout, "}");
+	fprintf(pairs.stream, "{");
+	err = map_for_each(block->env, i3bar_print_pair, &pairs);
+	fprintf(pairs.stream, "}");
+	fclose(pairs.stream);
 
-	return err;
+	if (err) {
+		free(buf);
+		return err;
+	}
+
+	block->json = buf;
+	block->jsonlen = len;
+
+	return 0;
 }
 
- int i3bar_print(const struct bar *bar)
+static unsigned int i3bar_count(const struct bar *bar)
 {
 	struct block *block = bar->blocks;
-	unsigned int mcount = 0;
+	unsigned int count = 0;
+
+	while (block) {
+		count++;
+		block = block->next;
+	}
+
+	return count;
+}
+
+int i3bar_print(const struct bar *bar)
+{
+	/* Opening, closing, and each object preceded by a separator */
+	struct iovec iov[2 * i3bar_count(bar) + 2];
+	struct block *block;
+	unsigned int n = 0;
 	int err;
 
 	if (bar->term) {
@@ -182,24 +214,35 @@ static int i3bar_print_block(struct block *block, void *data)
 		return 0;
 	}
 
-	fprintf(stdout, ",[");
-	while (block) {
-		err = i3bar_print_block(block, &mcount);
+	iov[n].iov_base = ",[";
+	iov[n++].iov_len = 2;
+
+	for (block = bar->blocks; block; block = block->next) {
+		err = i3bar_cache_block(block);
 		if (err)
-			break;
+			return err;
 
-		block = block->next;
+		if (!block->json)
+			continue;
+
+		if (n > 1) {
+			iov[n].iov_base = ",";
+			iov[n++].iov_len = 1;
+		}
+
+		iov[n].iov_base = block->json;
+		iov[n++].iov_len = block->jsonlen;
 	}
-	fprintf(stdout, "]\n");
-	fflush(stdout);
 
-	return err;
+	iov[n].iov_base = "]\n";
+	iov[n++].iov_len = 2;
+
+	return sys_writev(STDOUT_FILENO, iov, n);
 }
 
 int i3bar_printf(struct block *block, int lvl, const char *msg)
 {
-	const struct bar *bar = block->bar;
-	struct map *map = block->env;
+	struct bar *bar = block->bar;
 	int err;
 
 	if (bar->term || lvl > LOG_ERROR)
@@ -207,17 +250,25 @@ int i3bar_printf(struct block *block, int lvl, const char *msg)
 
 	block->tainted = true;
 
-	err = map_set(map, "full_text", msg);
+	err = block_set(block, "full_text", msg);
 	if (err)
 		return err;
 
 	if (lvl <= LOG_ERROR) {
-		err = map_set(map, "urgent", "true");
+		err = block_set(block, "urgent", "true");
 		if (err)
 			return err;
 	}
 
-	return i3bar_print(bar);
+	block->dirty = true;
+
+	/* Once the bar is polling, let it coalesce the rendering */
+	if (bar->epfd < 0)
+		return i3bar_print(bar);
+
+	bar->dirty = true;
+
+	return 0;
 }
 
 int i3bar_start(struct bar *bar)
@@ -279,7 +330,7 @@ int i3bar_click(struct bar *bar)
 
 	for (;;) {
 		/* Each click is one JSON object per line */
-		err = json_read(STDIN_FILENO, 1, click);
+		err = json_read(STDIN_FILENO, &bar->input, 1, click);
 		if (err) {
 			if (err == -EAGAIN)
 				err = 0;
@@ -296,12 +347,10 @@ int i3bar_click(struct bar *bar)
 					break;
 
 				block->tainted = false;
-
-				err = i3bar_print(bar);
-				if (err)
-					break;
+				block->dirty = true;
+				bar->dirty = true;
 			} else {
-				err = map_copy(block->env, click);
+				err = block_copy(block, click);
 				if (err)
 					break;
 
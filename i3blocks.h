@@ -0,0 +1,56 @@
+/*
+ * i3blocks.h - interface of native block plugins
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef I3BLOCKS_H
+#define I3BLOCKS_H
+
+/* Bumped on every incompatible change of this interface */
+#define I3BLOCKS_PLUGIN_ABI	1
+
+/* Name of the struct i3blocks_plugin exported by a shared object */
+#define I3BLOCKS_PLUGIN_SYMBOL	"i3blocks_plugin"
+
+/* Opaque handle to the block loading the plugin */
+struct block;
+
+/*
+ * All callbacks are optional, run on the event loop of the bar, and return
+ * 0 on success or a negative error code.
+ *
+ * The properties of the block are reset to the configuration before each
+ * update, then update() sets the keys to display, like a command would.
+ * click() and readable() are called right before the resulting update.
+ */
+struct i3blocks_plugin {
+	unsigned int abi; /* I3BLOCKS_PLUGIN_ABI */
+
+	int (*init)(struct block *block, void **data);
+	int (*update)(struct block *block, void *data);
+	int (*click)(struct block *block, void *data);
+	int (*readable)(struct block *block, void *data, int fd);
+	void (*destroy)(struct block *block, void *data);
+};
+
+const char *i3blocks_get(struct block *block, const char *key);
+int i3blocks_set(struct block *block, const char *key, const char *value);
+
+/* Get readable() called when a descriptor (e.g. a timerfd) is ready */
+int i3blocks_watch(struct block *block, int fd);
+void i3blocks_unwatch(struct block *block, int fd);
+
+#endif /* I3BLOCKS_H */
@@ -102,5 +102,5 @@ int ini_read(int fd, size_t count, ini_sec_cb_t *sec_cb, ini_prop_cb_t *prop_cb,
 		.data = data,
 	};
 
-	return line_read(fd, count, ini_parse_line, &ini);
+	return line_read(fd, NULL, count, ini_parse_line, &ini);
 }
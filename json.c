@@ -256,37 +256,23 @@ static size_t json_parse_literal(const char *str, const char *literal,
 /* A value can be a string, number, object, array, true, false, or null */
 static size_t json_parse_value(const char *str, char *buf, size_t size)
 {
-	size_t len;
-
-	len = json_parse_string(str, buf, size);
-	if (len)
-		return len;
-
-	len = json_parse_number(str, buf, size);
-	if (len)
-		return len;
-
-	len = json_parse_nested_object(str, buf, size);
-	if (len)
-		return len;
-
-	len = json_parse_nested_array(str, buf, size);
-	if (len)
-		return len;
-
-	len = json_parse_literal(str, "true", buf, size);
-	if (len)
-		return len;
-
-	len = json_parse_literal(str, "false", buf, size);
-	if (len)
-		return len;
-
-	len = json_parse_literal(str, "null", buf, size);
-	if (len)
-		return len;
-
-	return 0;
+	/* The first byte tells the type */
+	switch (*str) {
+	case '"':
+		return json_parse_string(str, buf, size);
+	case '{':
+		return json_parse_nested_object(str, buf, size);
+	case '[':
+		return json_parse_nested_array(str, buf, size);
+	case 't':
+		return json_parse_literal(str, "true", buf, size);
+	case 'f':
+		return json_parse_literal(str, "false", buf, size);
+	case 'n':
+		return json_parse_literal(str, "null", buf, size);
+	default:
+		return json_parse_number(str, buf, size);
+	}
 }
 
 /* Return the length of a separator optionally enclosed by whitespaces, 0 otherwise */
@@ -309,42 +295,57 @@ static size_t json_parse_sep(const char *str, char sep)
 	return len;
 }
 
-/* Parse an inline ["name"][\s+:\s+][value] name-value pair */
-static size_t json_parse_pair(const char *str, char *name, size_t namesiz,
-			      char *val, size_t valsiz)
+/*
+ * Parse an inline ["name"][\s+:\s+][value] name-value pair in place, in a
+ * single pass. Strings are unescaped over themselves (they never grow) and
+ * other values are terminated where they end, so that name and value point
+ * into the line. Return the length of the pair, 0 if it is invalid.
+ */
+static size_t json_parse_pair(char *str, char **name, char **val, char *delim)
 {
-	size_t pair_len = 0;
+	char *pos = str;
 	size_t len;
 
-	len = json_parse_string(str, name, namesiz);
+	/* Unescaping never writes past the bytes already read */
+	len = json_parse_string(pos, pos, SIZE_MAX);
 	if (!len)
 		return 0;
 
-	pair_len += len;
-	str += len;
+	*name = pos;
+	pos += len;
 
-	len = json_parse_sep(str, ':');
+	len = json_parse_sep(pos, ':');
 	if (!len)
 		return 0;
 
-	pair_len += len;
-	str += len;
+	pos += len;
 
-	len = json_parse_value(str, val, valsiz);
-	if (!len)
-		return 0;
+	if (*pos == '"') {
+		len = json_parse_string(pos, pos, SIZE_MAX);
+		if (!len)
+			return 0;
+	} else {
+		len = json_parse_value(pos, NULL, 0);
+		if (!len)
+			return 0;
+	}
 
-	pair_len += len;
+	*val = pos;
+	pos += len;
 
-	return pair_len;
+	/* Strings are already terminated, the rest is about to be */
+	*delim = *pos;
+	*pos = '\0';
+
+	return pos - str;
 }
 
 static int json_line_cb(char *line, size_t num, void *data)
 {
 	struct map *map = data;
-	char name[BUFSIZ];
-	char val[BUFSIZ];
+	char *name, *val;
 	size_t len;
+	char delim;
 	int err;
 
 	for (;;) {
@@ -356,22 +357,18 @@ static int json_line_cb(char *line, size_t num, void *data)
 		if (*line == '\0')
 			break;
 
-		memset(name, 0, sizeof(name));
-		memset(val, 0, sizeof(val));
-
-		len = json_parse_pair(line, name, sizeof(name), val,
-				      sizeof(val));
+		len = json_parse_pair(line, &name, &val, &delim);
 		if (!len)
 			return -EINVAL;
 
 		line += len;
 
 		/* valid delimiters after a pair */
-		if (*line != ',' && *line != '}' && *line != '\0' &&
-		    !isspace(*line))
+		if (delim != ',' && delim != '}' && delim != '\0' &&
+		    !isspace(delim))
 			return -EINVAL;
 
-		if (*line != '\0')
+		if (delim != '\0')
 			line++;
 
 		if (map) {
@@ -384,9 +381,9 @@ static int json_line_cb(char *line, size_t num, void *data)
 	return 0;
 }
 
-int json_read(int fd, size_t count, struct map *map)
+int json_read(int fd, struct line *line, size_t count, struct map *map)
 {
-	return line_read(fd, count, json_line_cb, map);
+	return line_read(fd, line, count, json_line_cb, map);
 }
 
 bool json_is_string(const char *str)
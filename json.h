@@ -23,7 +23,9 @@
 
 struct map;
 
-int json_read(int fd, size_t count, struct map *map);
+struct line;
+
+int json_read(int fd, struct line *line, size_t count, struct map *map);
 
 bool json_is_string(const char *str);
 bool json_is_valid(const char *str);
@@ -0,0 +1,63 @@
+/*
+ * key.c - implementation of the known property keys
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "key.h"
+
+static const char * const key_names[KEY_MAX] = {
+	[KEY_UNKNOWN] = "",
+	[KEY_FULL_TEXT] = "full_text",
+	[KEY_SHORT_TEXT] = "short_text",
+	[KEY_COLOR] = "color",
+	[KEY_BACKGROUND] = "background",
+	[KEY_BORDER] = "border",
+	[KEY_MIN_WIDTH] = "min_width",
+	[KEY_ALIGN] = "align",
+	[KEY_NAME] = "name",
+	[KEY_INSTANCE] = "instance",
+	[KEY_URGENT] = "urgent",
+	[KEY_SEPARATOR] = "separator",
+	[KEY_SEPARATOR_BLOCK_WIDTH] = "separator_block_width",
+	[KEY_MARKUP] = "markup",
+	[KEY_BORDER_TOP] = "border_top",
+	[KEY_BORDER_BOTTOM] = "border_bottom",
+	[KEY_BORDER_LEFT] = "border_left",
+	[KEY_BORDER_RIGHT] = "border_right",
+	[KEY_INTERVAL] = "interval",
+	[KEY_BUTTON] = "button",
+	[KEY_X] = "x",
+	[KEY_Y] = "y",
+};
+
+/* Called once per distinct key when maps intern it, never on a hot path */
+enum key key_lookup(const char *name)
+{
+	unsigned int i;
+
+	for (i = KEY_UNKNOWN + 1; i < KEY_MAX; i++)
+		if (strcmp(key_names[i], name) == 0)
+			return i;
+
+	return KEY_UNKNOWN;
+}
+
+const char *key_name(enum key key)
+{
+	return key_names[key];
+}
@@ -0,0 +1,59 @@
+/*
+ * key.h - definition of the known property keys
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEY_H
+#define KEY_H
+
+/* Keys of the i3bar protocol come first, in the order of the raw format */
+enum key {
+	KEY_UNKNOWN,
+
+	/* Standard keys */
+	KEY_FULL_TEXT,
+	KEY_SHORT_TEXT,
+	KEY_COLOR,
+	KEY_BACKGROUND,
+	KEY_BORDER,
+	KEY_MIN_WIDTH,
+	KEY_ALIGN,
+	KEY_NAME,
+	KEY_INSTANCE,
+	KEY_URGENT,
+	KEY_SEPARATOR,
+	KEY_SEPARATOR_BLOCK_WIDTH,
+	KEY_MARKUP,
+
+	/* i3-gaps features */
+	KEY_BORDER_TOP,
+	KEY_BORDER_BOTTOM,
+	KEY_BORDER_LEFT,
+	KEY_BORDER_RIGHT,
+
+	/* Click events and legacy variables */
+	KEY_INTERVAL,
+	KEY_BUTTON,
+	KEY_X,
+	KEY_Y,
+
+	KEY_MAX,
+};
+
+enum key key_lookup(const char *name);
+const char *key_name(enum key key);
+
+#endif /* KEY_H */
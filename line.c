@@ -16,49 +16,115 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE /* for memrchr(3) */
+
+#include <string.h>
+
 #include "line.h"
 #include "log.h"
 #include "sys.h"
 
-/* Read a single character and return a negative error code if none was read */
-static int line_getc(int fd, char *c)
+/* Read as many bytes as possible and return a negative error code if none was read */
+static int line_fill(int fd, struct line *line)
 {
-	return sys_read(fd, c, 1, NULL);
+	size_t count;
+	int err;
+
+	/* Move the pending bytes to the front to make room */
+	if (line->start) {
+		line->end -= line->start;
+		memmove(line->buf, line->buf + line->start, line->end);
+		line->start = 0;
+	}
+
+	/* Drop a line too long to buffer so that the reader makes progress */
+	if (line->end == sizeof(line->buf)) {
+		line->end = 0;
+		return -ENOSPC;
+	}
+
+	err = sys_read(fd, line->buf + line->end, sizeof(line->buf) - line->end,
+		       &count);
+	if (err)
+		return err;
+
+	line->end += count;
+
+	return 0;
+}
+
+/* Discard complete lines but the last one, keep the pending bytes after it */
+static void line_skip(struct line *line)
+{
+	char *start = line->buf + line->start;
+	char *last, *prev;
+
+	last = memrchr(start, '\n', line->end - line->start);
+	if (!last)
+		return;
+
+	prev = memrchr(start, '\n', last - start);
+	if (prev)
+		line->start = prev + 1 - line->buf;
 }
 
-/* Read a line including the newline character and return its positive length */
-static ssize_t line_gets(int fd, char *buf, size_t size)
+/* Read everything available, so that only the latest line remains */
+int line_drain(int fd, struct line *line)
 {
-	size_t len = 0;
 	int err;
 
 	for (;;) {
-		if (len == size)
-			return -ENOSPC;
+		line_skip(line);
+
+		err = line_fill(fd, line);
+		if (err) {
+			if (err == -EAGAIN)
+				return 0;
 
-		err = line_getc(fd, buf + len);
-		if (err)
 			return err;
+		}
+	}
+}
+
+/* Buffer a line including the newline character and return its positive length */
+static ssize_t line_gets(int fd, struct line *line)
+{
+	size_t scanned = 0;
+	char *newline;
+	int err;
 
-		if (buf[len++] == '\n')
+	for (;;) {
+		newline = memchr(line->buf + line->start + scanned, '\n',
+				 line->end - line->start - scanned);
+		if (newline)
 			break;
+
+		scanned = line->end - line->start;
+
+		err = line_fill(fd, line);
+		if (err)
+			return err;
 	}
 
 	/* at least 1 */
-	return len;
+	return newline - (line->buf + line->start) + 1;
 }
 
 /* Read a line excluding the newline character */
-static int line_parse(int fd, line_cb_t *cb, size_t num, void *data)
+static int line_parse(int fd, struct line *line, line_cb_t *cb, size_t num,
+		      void *data)
 {
-	char buf[BUFSIZ];
+	char *buf;
 	ssize_t len;
 	int err;
 
-	len = line_gets(fd, buf, sizeof(buf));
+	len = line_gets(fd, line);
 	if (len < 0)
 		return len;
 
+	buf = line->buf + line->start;
+	line->start += len;
+
 	/* replace newline with terminating null byte */
 	buf[len - 1] = '\0';
 
@@ -73,14 +139,24 @@ static int line_parse(int fd, line_cb_t *cb, size_t num, void *data)
 	return 0;
 }
 
-/* Read up to count lines excluding their newline character */
-int line_read(int fd, size_t count, line_cb_t *cb, void *data)
+/*
+ * Read up to count lines excluding their newline character.
+ * Without a buffer, bytes read ahead of the last parsed line are lost.
+ */
+int line_read(int fd, struct line *line, size_t count, line_cb_t *cb,
+	      void *data)
 {
+	struct line tmp;
 	size_t lines = 0;
 	int err;
 
+	if (!line) {
+		line_reset(&tmp);
+		line = &tmp;
+	}
+
 	while (count--) {
-		err = line_parse(fd, cb, lines++, data);
+		err = line_parse(fd, line, cb, lines++, data);
 		if (err)
 			return err;
 	}
@@ -19,9 +19,25 @@
 #ifndef IO_H
 #define IO_H
 
+#include <stdio.h>
 #include <unistd.h>
 
+/* Bytes read ahead from a descriptor, pending between start and end */
+struct line {
+	size_t start;
+	size_t end;
+	char buf[BUFSIZ];
+};
+
+static inline void line_reset(struct line *line)
+{
+	line->start = line->end = 0;
+}
+
+int line_drain(int fd, struct line *line);
+
 typedef int line_cb_t(char *line, size_t num, void *data);
-int line_read(int fd, size_t count, line_cb_t *cb, void *data);
+int line_read(int fd, struct line *line, size_t count, line_cb_t *cb,
+	      void *data);
 
 #endif /* IO_H */
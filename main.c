@@ -32,24 +32,45 @@ unsigned int log_level;
 
 int main(int argc, char *argv[])
 {
+	unsigned long frame = 16;
+	unsigned int jobs = 0;
+	bool spawner = false;
 	char *output = NULL;
 	char *path = NULL;
+	char *end;
 	bool term;
 	int c;
 
-	while (c = getopt(argc, argv, "c:o:vhV"), c != -1) {
+	while (c = getopt(argc, argv, "c:j:o:r:svhV"), c != -1) {
 		switch (c) {
 		case 'c':
 			path = optarg;
 			break;
+		case 'j':
+			jobs = strtoul(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0') {
+				error("invalid number of jobs '%s'", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'o':
 			output = optarg;
 			break;
+		case 'r':
+			frame = strtoul(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0') {
+				error("invalid render interval '%s'", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 's':
+			spawner = true;
+			break;
 		case 'v':
 			log_level++;
 			break;
 		case 'h':
-			printf("Usage: %s [-c <configfile>] [-o <output>] [-v] [-h] [-V]\n", argv[0]);
+			printf("Usage: %s [-c <configfile>] [-j <jobs>] [-o <output>] [-r <msec>] [-s] [-v] [-h] [-V]\n", argv[0]);
 			return EXIT_SUCCESS;
 		case 'V':
 			printf(PACKAGE_STRING " © 2014-2019 Vivien Didelot and contributors\n");
@@ -64,7 +85,7 @@ int main(int argc, char *argv[])
 	if (output)
 		term = !strcmp(output, "term");
 
-	if (bar_init(term, path))
+	if (bar_init(term, path, frame, spawner, jobs))
 		return EXIT_FAILURE;
 
 	return EXIT_SUCCESS;
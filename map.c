@@ -17,160 +17,345 @@
  */
 
 #include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 #include "map.h"
 
+/*
+ * Keys are interned once for the whole program, so that maps compare and
+ * hash them by address. They are few (properties of the configuration and
+ * of the i3bar protocol) and live until the program exits. Known keys are
+ * identified on the way in, so that users never compare strings again.
+ */
+struct map_key {
+	enum key id;
+	char name[];
+};
+
+static struct {
+	struct map_key **keys;
+	size_t mask;
+	size_t count;
+} map_keys;
+
 struct pair {
-	char *key;
+	const char *key;
 	char *value;
-
-	struct pair *next;
+	size_t size; /* allocated for the value */
 };
 
+/* Pairs are kept in insertion order, indexed by an open-addressing table */
 struct map {
-	struct pair *head;
+	struct pair *pairs;
+	size_t count;
+	size_t size;
+
+	/* Index of a pair plus one, 0 for a free slot */
+	size_t *slots;
+	size_t mask;
+
+	/* Optional plain map read through, but never written */
+	const struct map *base;
+
+	/* Values, all freed at once when the map is cleared */
+	struct arena *arena;
 };
 
-static struct pair *map_head(const struct map *map)
+static size_t map_strhash(const char *str)
 {
-	return map->head;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (*str) {
+		hash ^= (unsigned char) *str++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
 }
 
-/* Return previous pair if key is found, last pair otherwise */
-static struct pair *map_prev(const struct map *map, const char *key)
+static size_t map_ptrhash(const char *key)
 {
-	struct pair *prev = map_head(map);
-	struct pair *next = prev->next;
+	uint64_t hash = (uintptr_t) key;
 
-	while (next) {
-		if (strcmp(next->key, key) == 0)
-			break;
+	/* Fibonacci hashing, low bits of addresses are mostly aligned */
+	hash *= 0x9e3779b97f4a7c15ULL;
 
-		prev = next;
-		next = next->next;
-	}
+	return hash >> 32;
+}
+
+static struct map_key **map_intern_slot(struct map_key **keys, size_t mask,
+					const char *key)
+{
+	size_t i = map_strhash(key) & mask;
+
+	while (keys[i] && strcmp(keys[i]->name, key) != 0)
+		i = (i + 1) & mask;
 
-	return prev;
+	return &keys[i];
 }
 
-/* Update the value of a pair */
-static int map_reassign(struct pair *pair, const char *value)
+static int map_intern_grow(void)
 {
-	free(pair->value);
-	pair->value = NULL;
+	size_t mask = map_keys.keys ? map_keys.mask * 2 + 1 : 63;
+	struct map_key **keys;
+	size_t i;
 
-	if (value) {
-		pair->value = strdup(value);
-		if (!pair->value)
-			return -ENOMEM;
+	keys = calloc(mask + 1, sizeof(struct map_key *));
+	if (!keys)
+		return -ENOMEM;
+
+	if (map_keys.keys) {
+		for (i = 0; i <= map_keys.mask; i++)
+			if (map_keys.keys[i])
+				*map_intern_slot(keys, mask,
+						 map_keys.keys[i]->name) =
+					map_keys.keys[i];
+
+		free(map_keys.keys);
 	}
 
+	map_keys.keys = keys;
+	map_keys.mask = mask;
+
 	return 0;
 }
 
-/* Create a new key-value pair */
-static struct pair *map_pair(const char *key, const char *value)
+/* Return the interned copy of a key, NULL if unknown and not added */
+static const char *map_intern(const char *key, bool add)
 {
-	struct pair *pair;
-	int err;
+	struct map_key **slot;
+	size_t len;
 
-	pair = calloc(1, sizeof(struct pair));
-	if (!pair)
-		return NULL;
+	if (!map_keys.keys) {
+		if (!add || map_intern_grow())
+			return NULL;
+	}
+
+	slot = map_intern_slot(map_keys.keys, map_keys.mask, key);
+	if (*slot)
+		return (*slot)->name;
 
-	pair->key = strdup(key);
-	if (!pair->key) {
-		free(pair);
+	if (!add)
 		return NULL;
+
+	/* Keep the table at most half full */
+	if (2 * (map_keys.count + 1) > map_keys.mask + 1) {
+		if (map_intern_grow())
+			return NULL;
+
+		slot = map_intern_slot(map_keys.keys, map_keys.mask, key);
 	}
 
-	err = map_reassign(pair, value);
-	if (err) {
-		free(pair->key);
-		free(pair);
+	len = strlen(key) + 1;
+	*slot = malloc(sizeof(struct map_key) + len);
+	if (!*slot)
 		return NULL;
-	}
 
-	return pair;
+	(*slot)->id = key_lookup(key);
+	memcpy((*slot)->name, key, len);
+	map_keys.count++;
+
+	return (*slot)->name;
 }
 
-/* Destroy a new key-value pair */
-void map_unpair(struct pair *pair)
+/* Keys passed to map_func_t callbacks are interned, their id precedes them */
+enum key map_key_id(const char *key)
 {
-	map_reassign(pair, NULL);
-	free(pair->key);
-	free(pair);
+	const struct map_key *k;
+
+	k = (const struct map_key *) (key - offsetof(struct map_key, name));
+
+	return k->id;
 }
 
-/* Insert a key-value pair after a given pair */
-static int map_insert(struct pair *prev, const char *key, const char *value)
+/* Return the slot of an interned key, or the free slot to insert it */
+static size_t *map_slot(const struct map *map, const char *key)
 {
-	struct pair *pair;
+	size_t i = map_ptrhash(key) & map->mask;
+
+	while (map->slots[i] && map->pairs[map->slots[i] - 1].key != key)
+		i = (i + 1) & map->mask;
 
-	pair = map_pair(key, value);
-	if (!pair)
+	return &map->slots[i];
+}
+
+static struct pair *map_find(const struct map *map, const char *key)
+{
+	size_t index = *map_slot(map, key);
+
+	return index ? &map->pairs[index - 1] : NULL;
+}
+
+/* Double the capacity, with twice as many slots as pairs */
+static int map_grow(struct map *map)
+{
+	size_t size = map->size ? map->size * 2 : 8;
+	struct pair *pairs;
+	size_t *slots;
+	size_t i;
+
+	pairs = realloc(map->pairs, size * sizeof(struct pair));
+	if (!pairs)
+		return -ENOMEM;
+
+	map->pairs = pairs;
+
+	slots = calloc(2 * size, sizeof(size_t));
+	if (!slots)
 		return -ENOMEM;
 
-	pair->next = prev->next;
-	prev->next = pair;
+	free(map->slots);
+	map->slots = slots;
+	map->mask = 2 * size - 1;
+	map->size = size;
+
+	for (i = 0; i < map->count; i++)
+		*map_slot(map, map->pairs[i].key) = i + 1;
 
 	return 0;
 }
 
-/* Delete the key-value pair after a given pair */
-static void map_delete(struct pair *prev)
+/* Update the value of a pair, overwrites reuse its space when possible */
+static int map_reassign(struct map *map, struct pair *pair, const char *value)
 {
-	struct pair *pair = prev->next;
+	size_t len, size;
+	char *buf;
+
+	if (!value) {
+		pair->value = NULL;
+		pair->size = 0;
+		return 0;
+	}
+
+	len = strlen(value) + 1;
+	if (len > pair->size) {
+		/* Grow geometrically, values are only freed by a clear */
+		size = pair->size ? pair->size * 2 : len;
+		while (size < len)
+			size *= 2;
 
-	prev->next = pair->next;
-	map_unpair(pair);
+		buf = arena_alloc(map->arena, size);
+		if (!buf)
+			return -ENOMEM;
+
+		pair->value = buf;
+		pair->size = size;
+	}
+
+	memmove(pair->value, value, len);
+
+	return 0;
 }
 
 const char *map_get(const struct map *map, const char *key)
 {
-	struct pair *prev = map_prev(map, key);
-	struct pair *next = prev->next;
+	const struct pair *pair;
 
-	if (next)
-		return next->value;
-	else
+	/* A key never interned cannot be in any map */
+	key = map_intern(key, false);
+	if (!key)
 		return NULL;
+
+	pair = map_find(map, key);
+	if (!pair && map->base)
+		pair = map_find(map->base, key);
+
+	return pair ? pair->value : NULL;
 }
 
 int map_set(struct map *map, const char *key, const char *value)
 {
-	struct pair *prev = map_prev(map, key);
-	struct pair *next = prev->next;
+	struct pair *pair;
+	size_t *slot;
+	int err;
+
+	key = map_intern(key, true);
+	if (!key)
+		return -ENOMEM;
+
+	slot = map_slot(map, key);
+	if (*slot)
+		return map_reassign(map, &map->pairs[*slot - 1], value);
 
-	if (next)
-		return map_reassign(next, value);
-	else
-		return map_insert(prev, key, value);
+	if (map->count == map->size) {
+		err = map_grow(map);
+		if (err)
+			return err;
+
+		slot = map_slot(map, key);
+	}
+
+	pair = &map->pairs[map->count];
+	pair->key = key;
+	pair->value = NULL;
+	pair->size = 0;
+
+	err = map_reassign(map, pair, value);
+	if (err)
+		return err;
+
+	*slot = ++map->count;
+
+	return 0;
 }
 
-int map_for_each(const struct map *map, map_func_t *func, void *data)
+/* Overlays list the base pairs (or their override) first, like a copy */
+static int map_for_each_overlay(const struct map *map, map_func_t *func,
+				void *data)
 {
-	struct pair *pair = map_head(map);
+	const struct map *base = map->base;
+	const struct pair *pair;
+	size_t i;
 	int err;
 
-	while (pair->next) {
-		pair = pair->next;
+	for (i = 0; i < base->count; i++) {
+		pair = map_find(map, base->pairs[i].key) ? : &base->pairs[i];
 		err = func(pair->key, pair->value, data);
 		if (err)
 			return err;
 	}
 
+	for (i = 0; i < map->count; i++) {
+		if (map_find(base, map->pairs[i].key))
+			continue;
+
+		err = func(map->pairs[i].key, map->pairs[i].value, data);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+int map_for_each(const struct map *map, map_func_t *func, void *data)
+{
+	size_t i;
+	int err;
+
+	if (map->base)
+		return map_for_each_overlay(map, func, data);
+
+	for (i = 0; i < map->count; i++) {
+		err = func(map->pairs[i].key, map->pairs[i].value, data);
+		if (err)
+			return err;
+	}
+
 	return 0;
 }
 
 void map_clear(struct map *map)
 {
-	struct pair *pair = map_head(map);
+	arena_reset(map->arena);
 
-	while (pair->next)
-		map_delete(pair);
+	/* Keep the capacity, maps are refilled on every update */
+	memset(map->slots, 0, (map->mask + 1) * sizeof(size_t));
+	map->count = 0;
 }
 
 static int map_dup(const char *key, const char *value, void *data)
@@ -187,8 +372,9 @@ int map_copy(struct map *map, const struct map *base)
 
 void map_destroy(struct map *map)
 {
-	map_clear(map);
-	free(map->head);
+	arena_destroy(map->arena);
+	free(map->slots);
+	free(map->pairs);
 	free(map);
 }
 
@@ -200,11 +386,28 @@ struct map *map_create(void)
 	if (!map)
 		return NULL;
 
-	map->head = calloc(1, sizeof(struct pair));
-	if (!map->head) {
+	map->arena = arena_create();
+	if (!map->arena) {
 		free(map);
 		return NULL;
 	}
 
+	if (map_grow(map)) {
+		map_destroy(map);
+		return NULL;
+	}
+
+	return map;
+}
+
+/* Create an empty map shadowing a base map, which must outlive it */
+struct map *map_overlay(const struct map *base)
+{
+	struct map *map;
+
+	map = map_create();
+	if (map)
+		map->base = base;
+
 	return map;
 }
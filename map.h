@@ -19,9 +19,12 @@
 #ifndef MAP_H
 #define MAP_H
 
+#include "key.h"
+
 struct map;
 
 struct map *map_create(void);
+struct map *map_overlay(const struct map *base);
 void map_destroy(struct map *map);
 
 int map_copy(struct map *map, const struct map *base);
@@ -34,4 +37,7 @@ const char *map_get(const struct map *map, const char *key);
 typedef int map_func_t(const char *key, const char *value, void *data);
 int map_for_each(const struct map *map, map_func_t *func, void *data);
 
+/* Only valid for a key given by map_for_each */
+enum key map_key_id(const char *key);
+
 #endif /* MAP_H */
@@ -0,0 +1,134 @@
+/*
+ * plugin.c - implementation of native block plugins
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <dlfcn.h>
+
+#include "bar.h"
+#include "block.h"
+#include "log.h"
+#include "plugin.h"
+
+const char *i3blocks_get(struct block *block, const char *key)
+{
+	return block_get(block, key);
+}
+
+int i3blocks_set(struct block *block, const char *key, const char *value)
+{
+	return block_set(block, key, value);
+}
+
+int i3blocks_watch(struct block *block, int fd)
+{
+	return bar_watch(block->bar, block, fd);
+}
+
+void i3blocks_unwatch(struct block *block, int fd)
+{
+	bar_unwatch(block->bar, fd);
+}
+
+int plugin_update(struct block *block)
+{
+	const struct i3blocks_plugin *plugin = block->plugin;
+
+	if (!plugin->update)
+		return 0;
+
+	return plugin->update(block, block->plugin_data);
+}
+
+int plugin_click(struct block *block)
+{
+	const struct i3blocks_plugin *plugin = block->plugin;
+
+	if (!plugin->click)
+		return 0;
+
+	return plugin->click(block, block->plugin_data);
+}
+
+int plugin_readable(struct block *block, int fd)
+{
+	const struct i3blocks_plugin *plugin = block->plugin;
+
+	if (!plugin->readable)
+		return 0;
+
+	return plugin->readable(block, block->plugin_data, fd);
+}
+
+void plugin_unload(struct block *block)
+{
+	const struct i3blocks_plugin *plugin = block->plugin;
+
+	if (plugin && plugin->destroy)
+		plugin->destroy(block, block->plugin_data);
+
+	block->plugin = NULL;
+	block->plugin_data = NULL;
+
+	if (block->plugin_handle)
+		dlclose(block->plugin_handle);
+
+	block->plugin_handle = NULL;
+}
+
+int plugin_load(struct block *block, const char *path)
+{
+	const struct i3blocks_plugin *plugin;
+	int err;
+
+	/* Plugins only resolve i3blocks_* symbols from the executable */
+	block->plugin_handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!block->plugin_handle) {
+		block_error(block, "failed to load plugin: %s", dlerror());
+		return -ENOENT;
+	}
+
+	plugin = dlsym(block->plugin_handle, I3BLOCKS_PLUGIN_SYMBOL);
+	if (!plugin) {
+		block_error(block, "plugin %s has no %s symbol", path,
+			    I3BLOCKS_PLUGIN_SYMBOL);
+		plugin_unload(block);
+		return -EINVAL;
+	}
+
+	if (plugin->abi != I3BLOCKS_PLUGIN_ABI) {
+		block_error(block, "plugin %s has ABI %u, expected %u", path,
+			    plugin->abi, I3BLOCKS_PLUGIN_ABI);
+		plugin_unload(block);
+		return -EINVAL;
+	}
+
+	if (plugin->init) {
+		err = plugin->init(block, &block->plugin_data);
+		if (err) {
+			block_error(block, "failed to initialize plugin %s",
+				    path);
+			plugin_unload(block);
+			return err;
+		}
+	}
+
+	block->plugin = plugin;
+
+	block_debug(block, "loaded plugin %s", path);
+
+	return 0;
+}
@@ -0,0 +1,31 @@
+/*
+ * plugin.h - definition of native block plugins
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+#include "i3blocks.h"
+
+int plugin_load(struct block *block, const char *path);
+void plugin_unload(struct block *block);
+
+int plugin_update(struct block *block);
+int plugin_click(struct block *block);
+int plugin_readable(struct block *block, int fd);
+
+#endif /* PLUGIN_H */
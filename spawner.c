@@ -0,0 +1,448 @@
+/*
+ * spawner.c - implementation of the spawner process
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "block.h"
+#include "log.h"
+#include "spawner.h"
+#include "sys.h"
+
+/* Replies and events the bar is not reading yet, in order */
+struct spawner_queue {
+	struct spawner_msg *msgs;
+	size_t len;
+	size_t size;
+};
+
+/* Total size of a NULL-terminated array of strings, nul bytes included */
+static size_t spawner_strlen(char *const strv[], unsigned int *count)
+{
+	size_t len = 0;
+
+	for (*count = 0; strv[*count]; (*count)++)
+		len += strlen(strv[*count]) + 1;
+
+	return len;
+}
+
+static char *spawner_strcpy(char *pos, char *const strv[], unsigned int count)
+{
+	unsigned int i;
+	size_t len;
+
+	for (i = 0; i < count; i++) {
+		len = strlen(strv[i]) + 1;
+		memcpy(pos, strv[i], len);
+		pos += len;
+	}
+
+	return pos;
+}
+
+/* Ask the spawner to execute a program, its PID is returned asynchronously */
+int spawner_spawn(int sock, uint64_t cookie, char *const argv[],
+		  char *const envp[], int in, int out, bool pgroup)
+{
+	struct spawner_msg msg = {
+		.type = SPAWNER_SPAWN,
+		.pgroup = pgroup,
+		.cookie = cookie,
+	};
+	int fds[SYS_MAXFDS];
+	char cwd[PATH_MAX];
+	int nfds = 0;
+	char *buf, *pos;
+	size_t len;
+	int err;
+
+	/* Commands are relative to the configuration file */
+	err = sys_getcwd(cwd, sizeof(cwd));
+	if (err)
+		return err;
+
+	len = sizeof(msg) + strlen(cwd) + 1;
+	len += spawner_strlen(argv, &msg.argc);
+	len += spawner_strlen(envp, &msg.envc);
+
+	buf = malloc(len);
+	if (!buf)
+		return -ENOMEM;
+
+	memcpy(buf, &msg, sizeof(msg));
+	pos = buf + sizeof(msg);
+	pos = stpcpy(pos, cwd) + 1;
+	pos = spawner_strcpy(pos, argv, msg.argc);
+	spawner_strcpy(pos, envp, msg.envc);
+
+	/* The output always comes first, the input is optional */
+	fds[nfds++] = out;
+	if (in >= 0)
+		fds[nfds++] = in;
+
+	err = sys_sendfds(sock, buf, len, fds, nfds);
+	free(buf);
+
+	return err;
+}
+
+/* Read the next reply or exit event, -EAGAIN if there is none */
+int spawner_read(int sock, struct spawner_msg *msg)
+{
+	int fds[SYS_MAXFDS];
+	int nfds;
+
+	return sys_recvfds(sock, msg, sizeof(*msg), fds, &nfds);
+}
+
+/* Point to count strings of a request, making sure they are terminated */
+static char **spawner_strv(char **pos, const char *end, unsigned int count)
+{
+	unsigned int i;
+	char **strv;
+	char *nul;
+
+	strv = calloc(count + 1, sizeof(char *));
+	if (!strv)
+		return NULL;
+
+	for (i = 0; i < count; i++) {
+		nul = memchr(*pos, '\0', end - *pos);
+		if (!nul) {
+			free(strv);
+			return NULL;
+		}
+
+		strv[i] = *pos;
+		*pos = nul + 1;
+	}
+
+	return strv;
+}
+
+static int spawner_exec(struct spawner_msg *req, char *pos, const char *end,
+			int *fds, int nfds, pid_t *pid)
+{
+	char **argv, **envp;
+	const char *cwd;
+	int err;
+
+	cwd = pos;
+	pos = memchr(pos, '\0', end - pos);
+	if (!pos || !nfds || !req->argc)
+		return -EPROTO;
+
+	pos++;
+
+	argv = spawner_strv(&pos, end, req->argc);
+	if (!argv)
+		return -EPROTO;
+
+	envp = spawner_strv(&pos, end, req->envc);
+	if (!envp) {
+		free(argv);
+		return -EPROTO;
+	}
+
+	err = sys_chdir(cwd);
+	if (!err) {
+		err = sys_spawn(argv, envp, nfds > 1 ? fds[1] : -1, fds[0],
+				req->pgroup, pid);
+		if (err == -ENOSYS)
+			err = sys_forkexec(argv, envp, nfds > 1 ? fds[1] : -1,
+					   fds[0], req->pgroup, pid);
+	}
+
+	free(envp);
+	free(argv);
+
+	return err;
+}
+
+/* Send a message, or queue it behind those the bar did not read yet */
+static int spawner_send(int sock, struct spawner_queue *queue,
+			const struct spawner_msg *msg)
+{
+	struct spawner_msg *msgs;
+	size_t size;
+	int err;
+
+	if (!queue->len) {
+		err = sys_sendfds(sock, msg, sizeof(*msg), NULL, 0);
+		if (err != -EAGAIN)
+			return err;
+	}
+
+	if (queue->len == queue->size) {
+		size = queue->size ? queue->size * 2 : 16;
+		msgs = realloc(queue->msgs, size * sizeof(*msg));
+		if (!msgs)
+			return -ENOMEM;
+
+		queue->msgs = msgs;
+		queue->size = size;
+	}
+
+	queue->msgs[queue->len++] = *msg;
+
+	return 0;
+}
+
+static int spawner_flush(int sock, struct spawner_queue *queue)
+{
+	size_t sent = 0;
+	int err = 0;
+
+	while (sent < queue->len) {
+		err = sys_sendfds(sock, &queue->msgs[sent], sizeof(*queue->msgs),
+				  NULL, 0);
+		if (err)
+			break;
+
+		sent++;
+	}
+
+	queue->len -= sent;
+	memmove(queue->msgs, queue->msgs + sent,
+		queue->len * sizeof(*queue->msgs));
+
+	return err == -EAGAIN ? 0 : err;
+}
+
+static int spawner_request(int sock, struct spawner_queue *queue)
+{
+	struct spawner_msg reply = { .type = SPAWNER_SPAWNED };
+	struct spawner_msg *req;
+	int fds[SYS_MAXFDS];
+	int nfds, i;
+	size_t size;
+	char *buf;
+	int err;
+
+	err = sys_peeksize(sock, &size);
+	if (err)
+		return err;
+
+	if (size < sizeof(*req))
+		return -EPROTO;
+
+	buf = malloc(size);
+	if (!buf)
+		return -ENOMEM;
+
+	err = sys_recvfds(sock, buf, size, fds, &nfds);
+	if (err) {
+		free(buf);
+		return err;
+	}
+
+	req = (struct spawner_msg *) buf;
+	reply.cookie = req->cookie;
+	reply.code = spawner_exec(req, buf + sizeof(*req), buf + size, fds,
+				  nfds, &reply.pid);
+
+	/* The child has its own copies now */
+	for (i = 0; i < nfds; i++)
+		sys_close(fds[i]);
+
+	free(buf);
+
+	return spawner_send(sock, queue, &reply);
+}
+
+static int spawner_reap(int sock, struct spawner_queue *queue)
+{
+	struct spawner_msg event = { .type = SPAWNER_EXITED };
+	int err;
+
+	for (;;) {
+		err = sys_waitid(&event.pid);
+		if (err)
+			break;
+
+		err = sys_waitpid(event.pid, &event.code);
+		if (err)
+			return err;
+
+		err = spawner_send(sock, queue, &event);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int spawner_loop(int sock)
+{
+	struct spawner_queue queue = { 0 };
+	struct epoll_event events[2];
+	int epfd, sigfd;
+	int count, sig, i;
+	bool out = false;
+	sigset_t set;
+	int err;
+
+	err = sys_sigemptyset(&set);
+	if (err)
+		return err;
+
+	err = sys_sigaddset(&set, SIGCHLD);
+	if (err)
+		return err;
+
+	err = sys_signalfd(&set, &sigfd);
+	if (err)
+		return err;
+
+	/* Stop with the bar closing its socket, not on its control signals */
+	err = sys_sigaddset(&set, SIGTERM);
+	if (err)
+		return err;
+
+	err = sys_sigaddset(&set, SIGINT);
+	if (err)
+		return err;
+
+	/* Nor on signals sent to the bar by name, e.g. pkill -RTMIN+1 i3blocks */
+	err = sys_sigaddset(&set, SIGUSR1);
+	if (err)
+		return err;
+
+	err = sys_sigaddset(&set, SIGUSR2);
+	if (err)
+		return err;
+
+	for (sig = SIGRTMIN; sig <= SIGRTMAX; sig++) {
+		err = sys_sigaddset(&set, sig);
+		if (err)
+			return err;
+	}
+
+	err = sys_sigsetmask(&set);
+	if (err)
+		return err;
+
+	err = sys_epoll_create(&epfd);
+	if (err)
+		return err;
+
+	err = sys_epoll_add(epfd, sock);
+	if (err)
+		return err;
+
+	err = sys_epoll_add(epfd, sigfd);
+	if (err)
+		return err;
+
+	for (;;) {
+		err = sys_epoll_wait(epfd, events, 2, &count);
+		if (err) {
+			if (err == -EINTR)
+				continue;
+			return err;
+		}
+
+		for (i = 0; i < count; i++) {
+			if (events[i].data.fd == sigfd) {
+				err = sys_signalfd_read(sigfd, &sig);
+				if (err)
+					return err;
+
+				err = spawner_reap(sock, &queue);
+			} else {
+				if (events[i].events & EPOLLOUT) {
+					err = spawner_flush(sock, &queue);
+					if (err)
+						return err;
+				}
+
+				do {
+					err = spawner_request(sock, &queue);
+				} while (!err);
+
+				if (err == -EAGAIN)
+					err = 0;
+			}
+
+			if (err)
+				return err;
+		}
+
+		/* Wait for the bar to read its pending messages */
+		if (out != (queue.len > 0)) {
+			out = queue.len > 0;
+			err = sys_epoll_out(epfd, sock, out);
+			if (err)
+				return err;
+		}
+	}
+}
+
+/* Fork a small process to spawn commands on behalf of the bar */
+int spawner_start(int *sock, pid_t *pid)
+{
+	int fds[2];
+	int err;
+
+	err = sys_socketpair(fds);
+	if (err)
+		return err;
+
+	err = sys_fork(pid);
+	if (err) {
+		sys_close(fds[0]);
+		sys_close(fds[1]);
+		return err;
+	}
+
+	if (*pid == 0) {
+		sys_close(fds[0]);
+
+		/* Not an i3blocks process for pkill and friends */
+		err = sys_setname("i3b-spawner");
+		if (err)
+			debug("failed to rename the spawner");
+
+		err = spawner_loop(fds[1]);
+
+		/* The bar closed its end, wait for the commands like it would */
+		if (err == -EPIPE) {
+			sys_waitanychild();
+			sys_exit(EXIT_SUCCESS);
+		}
+
+		fatal("spawner failed: %s", strerror(-err));
+		sys_exit(EXIT_FAILURE);
+	}
+
+	sys_close(fds[1]);
+	*sock = fds[0];
+
+	/* Requests the spawner cannot take yet are queued by the bar */
+	err = sys_nonblock(*sock, true);
+	if (err) {
+		sys_close(*sock);
+		return err;
+	}
+
+	debug("spawner process %d started", *pid);
+
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * spawner.h - definition of the spawner process
+ * Copyright (C) 2019  Vivien Didelot
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPAWNER_H
+#define SPAWNER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define SPAWNER_SPAWN	0 /* request */
+#define SPAWNER_SPAWNED	1 /* reply, code is 0 or a negative error */
+#define SPAWNER_EXITED	2 /* event, code is the exit code */
+
+struct spawner_msg {
+	unsigned int type;
+	int code;
+	pid_t pid;
+
+	/* Request only, followed by the cwd, argv and envp strings */
+	unsigned int argc;
+	unsigned int envc;
+	unsigned int pgroup;
+
+	/* Opaque value identifying the requester */
+	uint64_t cookie;
+};
+
+int spawner_start(int *sock, pid_t *pid);
+
+int spawner_spawn(int sock, uint64_t cookie, char *const argv[],
+		  char *const envp[], int in, int out, bool pgroup);
+int spawner_read(int sock, struct spawner_msg *msg);
+
+#endif /* SPAWNER_H */
@@ -16,21 +16,36 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#define _GNU_SOURCE /* for F_SETSIG */
+#ifdef HAVE_CONFIG_H
+#include "i3blocks-config.h"
+#endif
 
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
+#ifdef HAVE_POSIX_SPAWN
+#include <spawn.h>
+#endif
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
-#include <sys/time.h>
+#include <sys/statvfs.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "log.h"
+#include "sys.h"
+
+extern char **environ;
 
 #define sys_errno(msg, ...) \
 	trace(msg ": %s", ##__VA_ARGS__, strerror(errno))
@@ -49,7 +64,32 @@ int sys_chdir(const char *path)
 	return 0;
 }
 
-int sys_gettime(unsigned long *interval)
+int sys_getcwd(char *buf, size_t size)
+{
+	if (!getcwd(buf, size)) {
+		sys_errno("getcwd()");
+		return -errno;
+	}
+
+	return 0;
+}
+
+int sys_setname(const char *name)
+{
+	int rc;
+
+	rc = prctl(PR_SET_NAME, name, 0, 0, 0);
+	if (rc == -1) {
+		sys_errno("prctl(PR_SET_NAME, %s)", name);
+		rc = -errno;
+		return rc;
+	}
+
+	return 0;
+}
+
+/* Read the monotonic clock in milliseconds */
+int sys_gettime(unsigned long long *msec)
 {
 	struct timespec ts;
 	int rc;
@@ -61,26 +101,53 @@ int sys_gettime(unsigned long *interval)
 		return rc;
 	}
 
-	*interval = ts.tv_sec;
+	*msec = ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
 
 	return 0;
 }
 
-int sys_setitimer(unsigned long interval)
+/* Wall-clock time and offset of the local timezone, in milliseconds */
+int sys_getrealtime(unsigned long long *msec, long long *gmtoff)
 {
-	struct itimerval itv = {
-		.it_value.tv_sec = interval,
-		.it_interval.tv_sec = interval,
-	};
+	struct timespec ts;
+	struct tm tm;
+	int rc;
+
+	rc = clock_gettime(CLOCK_REALTIME, &ts);
+	if (rc == -1) {
+		sys_errno("clock_gettime(CLOCK_REALTIME)");
+		rc = -errno;
+		return rc;
+	}
+
+	if (!localtime_r(&ts.tv_sec, &tm)) {
+		sys_errno("localtime_r(%ld)", (long) ts.tv_sec);
+		rc = -errno;
+		return rc;
+	}
+
+	*msec = ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+	*gmtoff = tm.tm_gmtoff * 1000LL;
+
+	return 0;
+}
+
+int sys_statvfs(const char *path, unsigned long long *avail,
+		unsigned long long *total)
+{
+	struct statvfs buf;
 	int rc;
 
-	rc = setitimer(ITIMER_REAL, &itv, NULL);
+	rc = statvfs(path, &buf);
 	if (rc == -1) {
-		sys_errno("setitimer(ITIMER_REAL, %ld)", interval);
+		sys_errno("statvfs(%s)", path);
 		rc = -errno;
 		return rc;
 	}
 
+	*avail = (unsigned long long) buf.f_bavail * buf.f_frsize;
+	*total = (unsigned long long) buf.f_blocks * buf.f_frsize;
+
 	return 0;
 }
 
@@ -142,20 +209,6 @@ int sys_waitanychild(void)
 	return 0;
 }
 
-int sys_setenv(const char *name, const char *value)
-{
-	int rc;
-
-	rc = setenv(name, value, 1);
-	if (rc == -1) {
-		sys_errno("setenv(%s=%s)", name, value);
-		rc = -errno;
-		return rc;
-	}
-
-	return 0;
-}
-
 const char *sys_getenv(const char *name)
 {
 	return getenv(name);
@@ -227,24 +280,6 @@ int sys_sigsetmask(const sigset_t *set)
 	return sys_sigprocmask(set, SIG_SETMASK);
 }
 
-int sys_sigwaitinfo(sigset_t *set, int *sig, int *fd)
-{
-	siginfo_t siginfo;
-	int rc;
-
-	rc = sigwaitinfo(set, &siginfo);
-	if (rc == -1) {
-		sys_errno("sigwaitinfo()");
-		rc = -errno;
-		return rc;
-	}
-
-	*sig = rc;
-	*fd = siginfo.si_fd;
-
-	return 0;
-}
-
 int sys_open(const char *path, int *fd)
 {
 	int rc;
@@ -299,47 +334,46 @@ int sys_read(int fd, void *buf, size_t size, size_t *count)
 	return 0;
 }
 
-int sys_dup(int fd1, int fd2)
+/* Write all vectors, resuming after partial writes */
+int sys_writev(int fd, struct iovec *iov, int iovcnt)
 {
-	int rc;
-
-	/* Defensive check */
-	if (fd1 == fd2)
-		return 0;
-
-	/* Close fd2, and reopen bound to fd1 */
-	rc = dup2(fd1, fd2);
-	if (rc == -1) {
-		sys_errno("dup2(%d, %d)", fd1, fd2);
-		rc = -errno;
-		return rc;
-	}
+	ssize_t rc;
 
-	return 0;
-}
+	while (iovcnt > 0) {
+		rc = writev(fd, iov, iovcnt < UIO_MAXIOV ? iovcnt : UIO_MAXIOV);
+		if (rc == -1) {
+			sys_errno("writev(%d, %d)", fd, iovcnt);
+			rc = -errno;
+			return rc;
+		}
 
-static int sys_setsig(int fd, int sig)
-{
-	int rc;
+		while (iovcnt > 0 && rc >= iov->iov_len) {
+			rc -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
 
-	rc = fcntl(fd, F_SETSIG, sig);
-	if (rc == -1) {
-		sys_errno("fcntl(%d, F_SETSIG, %d (%s))", fd, sig,
-			  strsignal(sig));
-		rc = -errno;
-		return rc;
+		if (iovcnt > 0) {
+			iov->iov_base = (char *) iov->iov_base + rc;
+			iov->iov_len -= rc;
+		}
 	}
 
 	return 0;
 }
 
-static int sys_setown(int fd, pid_t pid)
+int sys_dup(int fd1, int fd2)
 {
 	int rc;
 
-	rc = fcntl(fd, F_SETOWN, pid);
+	/* Defensive check */
+	if (fd1 == fd2)
+		return 0;
+
+	/* Close fd2, and reopen bound to fd1 */
+	rc = dup2(fd1, fd2);
 	if (rc == -1) {
-		sys_errno("fcntl(%d, F_SETOWN, %d)", fd, pid);
+		sys_errno("dup2(%d, %d)", fd1, fd2);
 		rc = -errno;
 		return rc;
 	}
@@ -419,10 +453,8 @@ int sys_cloexec(int fd)
 	return sys_setfd(fd, flags | FD_CLOEXEC);
 }
 
-/* Enable signal-driven I/O, formerly known as asynchronous I/O */
-int sys_async(int fd, int sig)
+int sys_nonblock(int fd, bool nonblock)
 {
-	pid_t pid;
 	int flags;
 	int err;
 
@@ -430,26 +462,335 @@ int sys_async(int fd, int sig)
 	if (err)
 		return err;
 
-	if (sig) {
-    		pid = getpid();
-		flags |= (O_ASYNC | O_NONBLOCK);
-	} else {
-    		pid = 0;
-		flags &= ~(O_ASYNC | O_NONBLOCK);
+	if (nonblock)
+		flags |= O_NONBLOCK;
+	else
+		flags &= ~O_NONBLOCK;
+
+	return sys_setfl(fd, flags);
+}
+
+int sys_epoll_create(int *fd)
+{
+	int rc;
+
+	rc = epoll_create1(EPOLL_CLOEXEC);
+	if (rc == -1) {
+		sys_errno("epoll_create1()");
+		rc = -errno;
+		return rc;
 	}
 
-	/* Establish a handler for the signal */
-	err = sys_setsig(fd, sig);
-	if (err)
-		return err;
+	*fd = rc;
+
+	return 0;
+}
+
+static int sys_epoll_ctl(int epfd, int op, int fd, uint32_t events)
+{
+	struct epoll_event event = {
+		.events = events,
+		.data.fd = fd,
+	};
+	int rc;
+
+	rc = epoll_ctl(epfd, op, fd, &event);
+	if (rc == -1) {
+		sys_errno("epoll_ctl(%d, %d, %d)", epfd, op, fd);
+		rc = -errno;
+		return rc;
+	}
+
+	return 0;
+}
+
+/* Watch a file descriptor for level-triggered readiness */
+int sys_epoll_add(int epfd, int fd)
+{
+	return sys_epoll_ctl(epfd, EPOLL_CTL_ADD, fd, EPOLLIN);
+}
 
-	/* Set calling process as owner, that is to receive the signal */
-	err = sys_setown(fd, pid);
+/* Also watch a descriptor for writability, or stop doing so */
+int sys_epoll_out(int epfd, int fd, bool out)
+{
+	return sys_epoll_ctl(epfd, EPOLL_CTL_MOD, fd,
+			     out ? EPOLLIN | EPOLLOUT : EPOLLIN);
+}
+
+int sys_epoll_del(int epfd, int fd)
+{
+	return sys_epoll_ctl(epfd, EPOLL_CTL_DEL, fd, 0);
+}
+
+int sys_epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+		   int *count)
+{
+	int rc;
+
+	rc = epoll_wait(epfd, events, maxevents, -1);
+	if (rc == -1) {
+		sys_errno("epoll_wait(%d)", epfd);
+		rc = -errno;
+		return rc;
+	}
+
+	*count = rc;
+
+	return 0;
+}
+
+/* Receive the given (blocked) signals through a file descriptor */
+int sys_signalfd(const sigset_t *set, int *fd)
+{
+	int rc;
+
+	rc = signalfd(-1, set, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (rc == -1) {
+		sys_errno("signalfd()");
+		rc = -errno;
+		return rc;
+	}
+
+	*fd = rc;
+
+	return 0;
+}
+
+int sys_signalfd_read(int fd, int *sig)
+{
+	struct signalfd_siginfo siginfo;
+	int err;
+
+	err = sys_read(fd, &siginfo, sizeof(siginfo), NULL);
 	if (err)
 		return err;
 
-	/* Enable/disable nonblocking I/O and signal-driven I/O */
-	return sys_setfl(fd, flags);
+	*sig = siginfo.ssi_signo;
+
+	return 0;
+}
+
+int sys_timerfd_create(int *fd)
+{
+	int rc;
+
+	rc = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (rc == -1) {
+		sys_errno("timerfd_create(CLOCK_MONOTONIC)");
+		rc = -errno;
+		return rc;
+	}
+
+	*fd = rc;
+
+	return 0;
+}
+
+/* Arm a one-shot timer expiring at the given monotonic time in milliseconds */
+int sys_timerfd_settime(int fd, unsigned long long msec)
+{
+	struct itimerspec its = {
+		.it_value.tv_sec = msec / 1000,
+		.it_value.tv_nsec = (msec % 1000) * 1000000,
+	};
+	int rc;
+
+	rc = timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL);
+	if (rc == -1) {
+		sys_errno("timerfd_settime(%d, %llums)", fd, msec);
+		rc = -errno;
+		return rc;
+	}
+
+	return 0;
+}
+
+int sys_clockfd_create(int *fd)
+{
+	int rc;
+
+	rc = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (rc == -1) {
+		sys_errno("timerfd_create(CLOCK_REALTIME)");
+		rc = -errno;
+		return rc;
+	}
+
+	*fd = rc;
+
+	return 0;
+}
+
+/* Same as above for the real time, reading fails with -ECANCELED on clock set */
+int sys_clockfd_settime(int fd, unsigned long long msec)
+{
+	struct itimerspec its = {
+		.it_value.tv_sec = msec / 1000,
+		.it_value.tv_nsec = (msec % 1000) * 1000000,
+	};
+	int rc;
+
+	rc = timerfd_settime(fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET,
+			     &its, NULL);
+	if (rc == -1) {
+		sys_errno("timerfd_settime(%d, %llums)", fd, msec);
+		rc = -errno;
+		return rc;
+	}
+
+	return 0;
+}
+
+int sys_socketpair(int *fds)
+{
+	int rc;
+
+	/* Message boundaries are preserved, so are descriptors passed along */
+	rc = socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds);
+	if (rc == -1) {
+		sys_errno("socketpair()");
+		rc = -errno;
+		return rc;
+	}
+
+	return 0;
+}
+
+/* Send a message along with up to SYS_MAXFDS descriptors, or -EAGAIN */
+int sys_sendfds(int sock, const void *buf, size_t len, const int *fds,
+		int nfds)
+{
+	char control[CMSG_SPACE(SYS_MAXFDS * sizeof(int))] = { 0 };
+	struct iovec iov = { (void *) buf, len };
+	struct msghdr msg = { 0 };
+	struct cmsghdr *cmsg;
+	ssize_t rc;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (nfds > 0) {
+		msg.msg_control = control;
+		msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+		memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+	}
+
+	/* Never block, a full socket is the caller's to queue for */
+	rc = sendmsg(sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (rc == -1) {
+		sys_errno("sendmsg(%d, %ld)", sock, len);
+		rc = -errno;
+		if (rc == -EWOULDBLOCK)
+			rc = -EAGAIN;
+		return rc;
+	}
+
+	return 0;
+}
+
+/* Size of the next pending message, without consuming it */
+int sys_peeksize(int sock, size_t *size)
+{
+	ssize_t rc;
+
+	rc = recv(sock, NULL, 0, MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT);
+	if (rc == -1) {
+		sys_errno("recv(%d)", sock);
+		rc = -errno;
+		if (rc == -EWOULDBLOCK)
+			rc = -EAGAIN;
+		return rc;
+	}
+
+	/* Peer closed */
+	if (rc == 0)
+		return -EPIPE;
+
+	*size = rc;
+
+	return 0;
+}
+
+/* Receive a message along with up to SYS_MAXFDS descriptors (cloexec) */
+int sys_recvfds(int sock, void *buf, size_t size, int *fds, int *nfds)
+{
+	char control[CMSG_SPACE(SYS_MAXFDS * sizeof(int))];
+	struct iovec iov = { buf, size };
+	struct msghdr msg = { 0 };
+	struct cmsghdr *cmsg;
+	ssize_t rc;
+	int i;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	rc = recvmsg(sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+	if (rc == -1) {
+		sys_errno("recvmsg(%d)", sock);
+		rc = -errno;
+		if (rc == -EWOULDBLOCK)
+			rc = -EAGAIN;
+		return rc;
+	}
+
+	/* Peer closed */
+	if (rc == 0)
+		return -EPIPE;
+
+	*nfds = 0;
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg && cmsg->cmsg_level == SOL_SOCKET &&
+	    cmsg->cmsg_type == SCM_RIGHTS) {
+		*nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		memcpy(fds, CMSG_DATA(cmsg), *nfds * sizeof(int));
+	}
+
+	if (rc != size || msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+		for (i = 0; i < *nfds; i++)
+			sys_close(fds[i]);
+
+		*nfds = 0;
+
+		return -EMSGSIZE;
+	}
+
+	return 0;
+}
+
+int sys_setpgid(pid_t pid)
+{
+	int rc;
+
+	rc = setpgid(pid, pid);
+	if (rc == -1) {
+		sys_errno("setpgid(%d)", pid);
+		rc = -errno;
+		return rc;
+	}
+
+	return 0;
+}
+
+int sys_kill(pid_t pid, int sig)
+{
+	int rc;
+
+	rc = kill(pid, sig);
+	if (rc == -1) {
+		sys_errno("kill(%d, %d)", pid, sig);
+		rc = -errno;
+		return rc;
+	}
+
+	return 0;
 }
 
 int sys_pipe(int *fds)
@@ -487,15 +828,13 @@ void sys_exit(int status)
 	_exit(status);
 }
 
-int sys_execsh(const char *command)
+int sys_execvp(char *const argv[])
 {
 	int rc;
 
-	static const char * const shell = "/bin/sh";
-
-	rc = execl(shell, shell, "-c", command, (char *) NULL);
+	rc = execvp(argv[0], argv);
 	if (rc == -1) {
-		sys_errno("execl(%s -c \"%s\")", shell, command);
+		sys_errno("execvp(%s)", argv[0]);
 		rc = -errno;
 		return rc;
 	}
@@ -504,6 +843,218 @@ int sys_execsh(const char *command)
 	return 0;
 }
 
+static int sys_forkexec_fd(int fd, int fd2)
+{
+	int err;
+
+	if (fd == fd2)
+		return 0;
+
+	err = sys_dup(fd, fd2);
+	if (err)
+		return err;
+
+	return sys_close(fd);
+}
+
+/* Set up a forked child like sys_spawn() does, only returns on error */
+static int sys_forkexec_child(char *const argv[], char *const envp[], int in,
+			      int out)
+{
+	sigset_t set;
+	int err;
+
+	/* execvp(3) uses the new environ */
+	environ = (char **) envp;
+
+	if (in < 0) {
+		err = sys_open("/dev/null", &in);
+		if (err)
+			return err;
+	}
+
+	err = sys_forkexec_fd(in, STDIN_FILENO);
+	if (err)
+		return err;
+
+	err = sys_forkexec_fd(out, STDOUT_FILENO);
+	if (err)
+		return err;
+
+	/* Children start with all signals unblocked */
+	err = sys_sigfillset(&set);
+	if (err)
+		return err;
+
+	err = sys_sigunblock(&set);
+	if (err)
+		return err;
+
+	return sys_execvp(argv);
+}
+
+/* Fork and execute a program, where posix_spawn is not available */
+int sys_forkexec(char *const argv[], char *const envp[], int in, int out,
+		 bool pgroup, pid_t *pid)
+{
+	int err;
+
+	err = sys_fork(pid);
+	if (err)
+		return err;
+
+	/* Set by both processes to avoid racing with a kill */
+	if (pgroup) {
+		err = sys_setpgid(*pid);
+		if (err && *pid == 0)
+			sys_exit(EXIT_ERR_INTERNAL);
+	}
+
+	if (*pid)
+		return 0;
+
+	err = sys_forkexec_child(argv, envp, in, out);
+
+	/* Mimic the shell for commands executed directly */
+	if (err == -ENOENT)
+		sys_exit(127);
+	if (err == -EACCES)
+		sys_exit(126);
+
+	sys_exit(EXIT_ERR_INTERNAL);
+
+	/* Unreachable */
+	return 0;
+}
+
+#ifdef HAVE_POSIX_SPAWN
+static int sys_spawn_actions(posix_spawn_file_actions_t *actions, int in,
+			     int out)
+{
+	int rc = 0;
+
+	if (in < 0) {
+		rc = posix_spawn_file_actions_addopen(actions, STDIN_FILENO,
+						      "/dev/null", O_RDONLY, 0);
+	} else if (in != STDIN_FILENO) {
+		rc = posix_spawn_file_actions_adddup2(actions, in, STDIN_FILENO);
+		if (rc == 0)
+			rc = posix_spawn_file_actions_addclose(actions, in);
+	}
+
+	if (rc == 0 && out != STDOUT_FILENO) {
+		rc = posix_spawn_file_actions_adddup2(actions, out, STDOUT_FILENO);
+		if (rc == 0)
+			rc = posix_spawn_file_actions_addclose(actions, out);
+	}
+
+	return rc;
+}
+
+static int sys_spawn_attr(posix_spawnattr_t *attr, bool pgroup)
+{
+	short flags = POSIX_SPAWN_SETSIGMASK;
+	sigset_t set;
+	int rc;
+
+	/* Children start with all signals unblocked */
+	sigemptyset(&set);
+
+	rc = posix_spawnattr_setsigmask(attr, &set);
+	if (rc)
+		return rc;
+
+	/* Lead a new process group, to be killed as a whole */
+	if (pgroup) {
+		rc = posix_spawnattr_setpgroup(attr, 0);
+		if (rc)
+			return rc;
+
+		flags |= POSIX_SPAWN_SETPGROUP;
+	}
+
+	return posix_spawnattr_setflags(attr, flags);
+}
+
+static int sys_spawnp(char *const argv[], char *const envp[], int in, int out,
+		      bool pgroup, pid_t *pid)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t attr;
+	int rc;
+
+	rc = posix_spawn_file_actions_init(&actions);
+	if (rc == 0) {
+		rc = posix_spawnattr_init(&attr);
+		if (rc == 0) {
+			rc = sys_spawn_actions(&actions, in, out);
+			if (rc == 0)
+				rc = sys_spawn_attr(&attr, pgroup);
+			if (rc == 0)
+				rc = posix_spawnp(pid, argv[0], &actions,
+						  &attr, argv, envp);
+
+			posix_spawnattr_destroy(&attr);
+		}
+
+		posix_spawn_file_actions_destroy(&actions);
+	}
+
+	return rc;
+}
+
+/* Let the shell run a script without a shebang, like execvp(3) does */
+static int sys_spawn_script(char *const argv[], char *const envp[], int in,
+			    int out, bool pgroup, pid_t *pid)
+{
+	size_t argc = 0;
+	char **shargv;
+	int rc;
+
+	while (argv[argc])
+		argc++;
+
+	shargv = calloc(argc + 4, sizeof(char *));
+	if (!shargv)
+		return ENOMEM;
+
+	shargv[0] = "/bin/sh";
+	shargv[1] = "-c";
+	shargv[2] = "exec \"$0\" \"$@\"";
+	memcpy(shargv + 3, argv, argc * sizeof(char *));
+
+	rc = sys_spawnp(shargv, envp, in, out, pgroup, pid);
+	free(shargv);
+
+	return rc;
+}
+#endif
+
+/* Spawn a program reading from in (/dev/null if negative) and writing to out */
+int sys_spawn(char *const argv[], char *const envp[], int in, int out,
+	      bool pgroup, pid_t *pid)
+{
+#ifdef HAVE_POSIX_SPAWN
+	int rc;
+
+	rc = sys_spawnp(argv, envp, in, out, pgroup, pid);
+
+	/* Unlike execvp(3), glibc 2.27+ posix_spawnp(3) has no such fallback */
+	if (rc == ENOEXEC)
+		rc = sys_spawn_script(argv, envp, in, out, pgroup, pid);
+
+	if (rc) {
+		errno = rc;
+		sys_errno("posix_spawnp(%s)", argv[0]);
+		return -rc;
+	}
+
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
 int sys_isatty(int fd)
 {
 	int rc;
@@ -21,18 +21,27 @@
 
 #include <libgen.h> /* for dirname(3) */
 #include <signal.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+/* Exit code of children failing on our side, before executing a program */
+#define EXIT_ERR_INTERNAL	66
+
 int sys_chdir(const char *path);
+int sys_getcwd(char *buf, size_t size);
+int sys_setname(const char *name);
 
-int sys_gettime(unsigned long *interval);
-int sys_setitimer(unsigned long interval);
+int sys_gettime(unsigned long long *msec);
+int sys_getrealtime(unsigned long long *msec, long long *gmtoff);
+int sys_statvfs(const char *path, unsigned long long *avail,
+		unsigned long long *total);
 
 int sys_waitid(pid_t *pid);
 int sys_waitpid(pid_t pid, int *code);
 int sys_waitanychild(void);
 
-int sys_setenv(const char *name, const char *value);
 const char *sys_getenv(const char *name);
 
 int sys_sigemptyset(sigset_t *set);
@@ -40,19 +49,46 @@ int sys_sigfillset(sigset_t *set);
 int sys_sigaddset(sigset_t *set, int sig);
 int sys_sigunblock(const sigset_t *set);
 int sys_sigsetmask(const sigset_t *set);
-int sys_sigwaitinfo(sigset_t *set, int *sig, int *fd);
 
 int sys_open(const char *path, int *fd);
 int sys_close(int fd);
 int sys_read(int fd, void *buf, size_t size, size_t *count);
+int sys_writev(int fd, struct iovec *iov, int iovcnt);
 int sys_dup(int fd1, int fd2);
 int sys_cloexec(int fd);
-int sys_async(int fd, int sig);
+int sys_nonblock(int fd, bool nonblock);
+
+int sys_epoll_create(int *fd);
+int sys_epoll_add(int epfd, int fd);
+int sys_epoll_out(int epfd, int fd, bool out);
+int sys_epoll_del(int epfd, int fd);
+int sys_epoll_wait(int epfd, struct epoll_event *events, int maxevents,
+		   int *count);
+int sys_signalfd(const sigset_t *set, int *fd);
+int sys_signalfd_read(int fd, int *sig);
+int sys_timerfd_create(int *fd);
+int sys_timerfd_settime(int fd, unsigned long long msec);
+int sys_clockfd_create(int *fd);
+int sys_clockfd_settime(int fd, unsigned long long msec);
 
 int sys_pipe(int *fds);
+
+#define SYS_MAXFDS	2
+
+int sys_socketpair(int *fds);
+int sys_sendfds(int sock, const void *buf, size_t len, const int *fds,
+		int nfds);
+int sys_peeksize(int sock, size_t *size);
+int sys_recvfds(int sock, void *buf, size_t size, int *fds, int *nfds);
 int sys_fork(pid_t *pid);
 void sys_exit(int status);
-int sys_execsh(const char *command);
+int sys_execvp(char *const argv[]);
+int sys_forkexec(char *const argv[], char *const envp[], int in, int out,
+		 bool pgroup, pid_t *pid);
+int sys_spawn(char *const argv[], char *const envp[], int in, int out,
+	      bool pgroup, pid_t *pid);
+int sys_setpgid(pid_t pid);
+int sys_kill(pid_t pid, int sig);
 
 int sys_isatty(int fd);
 